@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstdint>
+
+   /**
+    * Deterministic fixed-point arithmetic for the balancer invariant.
+    *
+    * Values are unsigned 64.64 fixed point numbers held in a 128-bit integer (the
+    *   high 64 bits are the integer part, the low 64 bits the fraction). Only integer
+    *   arithmetic is used, so results are bit-identical on every node and avoid the softfloat `log`/`exp` calls of a double implementation.
+    *
+    * Error bounds (checked against an 80-bit long double reference by
+    *   tests/native/fixedmath.test.cpp):
+    *   - `log2`, `ln` for 1 <= x < 2^63 : absolute error below 2^-57
+    *   - `exp2_frac` on [0,1)          : relative error below 2^-60
+    *   - `exp` for results up to 2^62  : relative error below 2^-56
+    *   - `exp_neg`                      : absolute error below 2^-60
+    *   - `pow_ratio`                    : error below 2^-56 * (1 + w_num/w_den) * result
+    *                                      + 2^-60
+    *   - `out_bal_after_in`, `in_bal_after_out` : within one token unit of the
+    *                                      exactly rounded balance
+    * `exp` and `mul` saturate to `max_value` instead of overflowing.
+    *
+    * The header has no eosio dependencies so that it may be tested natively.
+    */
+
+namespace oswaps_math {
+
+typedef unsigned __int128 uint128;
+
+constexpr uint128 one = uint128(1) << 64;
+constexpr uint128 max_value = ~uint128(0);
+// ln(2) and log2(e) in 64.64, rounded to nearest
+constexpr uint128 ln_2 = uint128(0xb17217f7d1cf79acull);
+constexpr uint128 log2_e = (uint128(1) << 64) | uint128(0x71547652b82fe177ull);
+
+#ifdef OSWAPS_MATH_COUNT_OPS
+// number of 64x64-bit multiplies performed, for benchmarking
+inline uint64_t mul_count = 0;
+#endif
+
+inline uint128 mul64(uint64_t a, uint64_t b) {
+#ifdef OSWAPS_MATH_COUNT_OPS
+  ++mul_count;
+#endif
+  return uint128(a) * b;
+}
+
+// 64.64 product, truncated; saturates to max_value on overflow
+inline uint128 mul(uint128 a, uint128 b) {
+  uint64_t ah = uint64_t(a >> 64), al = uint64_t(a);
+  uint64_t bh = uint64_t(b >> 64), bl = uint64_t(b);
+  uint128 hi = (ah && bh) ? mul64(ah, bh) : 0;
+  if (hi >> 64) {
+    return max_value;
+  }
+  uint128 r = hi << 64;
+  uint128 parts[3] = { ah ? mul64(ah, bl) : 0, bh ? mul64(al, bh) : 0,
+                       mul64(al, bl) >> 64 };
+  for (uint128 p : parts) {
+    if (r + p < r) {
+      return max_value;
+    }
+    r += p;
+  }
+  return r;
+}
+
+// (a << 64) / b as 64.64, i.e. the ratio of two integers; requires a < 2^63, b > 0
+inline uint128 ratio(uint64_t a, uint64_t b) {
+  return (uint128(a) << 64) / b;
+}
+
+inline int msb(uint128 x) {
+  uint64_t hi = uint64_t(x >> 64);
+  return hi ? 127 - __builtin_clzll(hi) : 63 - __builtin_clzll(uint64_t(x));
+}
+
+// log2(x) for x >= 1.0
+inline uint128 log2(uint128 x) {
+  int p = msb(x);
+  uint128 result = uint128(p - 64) << 64;
+  // mantissa in [1,2) as Q1.63
+  uint64_t m = uint64_t(x >> (p - 63));
+  // each squaring of the mantissa yields one more fraction bit
+  for (uint64_t bit = uint64_t(1) << 63; bit > 0; bit >>= 1) {
+    uint128 sq = mul64(m, m) >> 63;
+    if (sq >> 64) {
+      m = uint64_t(sq >> 1);
+      result |= bit;
+    } else {
+      m = uint64_t(sq);
+    }
+  }
+  return result;
+}
+
+// natural log ln(x) for x >= 1.0
+inline uint128 ln(uint128 x) {
+  return mul(log2(x), ln_2);
+}
+
+// 2^f for a fraction 0 <= f < 1, result in [1, 2)
+inline uint128 exp2_frac(uint64_t f) {
+  // 2^f = e^z with z = f*ln2 < 0.7; Taylor series to 19th order, 2^-64 / k! in 64.64
+  static constexpr uint64_t inv_fact[20] = {
+    0, 0, 0x8000000000000000ull, 0x2aaaaaaaaaaaaaabull, 0x0aaaaaaaaaaaaaabull,
+    0x0222222222222222ull, 0x005b05b05b05b05bull, 0x000d00d00d00d00dull,
+    0x0001a01a01a01a02ull, 0x00002e3bc74aad8eull, 0x0000049f93edde28ull,
+    0x0000006b99159fd5ull, 0x00000008f76c77fcull, 0x00000000b092309dull,
+    0x000000000c9cba54ull, 0x0000000000d73f9full, 0x00000000000d73faull,
+    0x000000000000ca96ull, 0x0000000000000b41ull, 0x0000000000000098ull };
+  uint64_t z = uint64_t(mul(f, ln_2));
+  uint128 acc = inv_fact[19];
+  for (int k = 18; k >= 2; --k) {
+    acc = (mul64(uint64_t(acc), z) >> 64) + inv_fact[k];
+  }
+  // terms of order 1 and 0 have coefficient one
+  acc = one + (mul64(uint64_t(acc), z) >> 64);
+  return one + mul(acc, z);
+}
+
+// e^x for x >= 0; saturates to max_value when the result exceeds 2^63
+inline uint128 exp(uint128 x) {
+  uint128 y = mul(x, log2_e);
+  uint128 n = y >> 64;
+  if (n >= 63) {
+    return max_value;
+  }
+  return exp2_frac(uint64_t(y)) << n;
+}
+
+// e^-x for x >= 0; result in (0, 1], or zero when below 2^-64
+inline uint128 exp_neg(uint128 x) {
+  uint128 y = mul(x, log2_e);
+  uint128 n = y >> 64;
+  uint64_t f = uint64_t(y);
+  if (f == 0) {
+    return n >= 128 ? 0 : one >> n;
+  }
+  // 2^-(n+f) = 2^(1-f) / 2^(n+1)
+  if (n + 1 >= 128) {
+    return 0;
+  }
+  return exp2_frac(uint64_t(0) - f) >> (n + 1);
+}
+
+// (num/den)^(w_num/w_den) for positive integers num, den < 2^63 and weights w > 0
+inline uint128 pow_ratio(uint64_t num, uint64_t den, uint64_t w_num, uint64_t w_den) {
+  if (num == den) {
+    return one;
+  }
+  uint128 w = (uint128(w_num) << 64) / w_den;
+  if (num > den) {
+    return exp(mul(ln(ratio(num, den)), w));
+  }
+  return exp_neg(mul(ln(ratio(den, num)), w));
+}
+
+// bal * f for a 64.64 factor f, rounded to nearest; saturates to max_value
+inline uint128 scale(uint64_t bal, uint128 f) {
+  uint128 hi = mul64(bal, uint64_t(f >> 64));
+  if (hi >> 64) {
+    return max_value;
+  }
+  return hi + ((mul64(bal, uint64_t(f)) + (uint128(1) << 63)) >> 64);
+}
+
+   /**
+    * Balancer invariant B_in^W_in * B_out^W_out = const for one swap.
+    *
+    * `out_bal_after_in` returns the output token pool balance after `in_amount` is
+    *   added to the input balance: B_out * (B_in / (B_in + in_amount))^(W_in/W_out).
+    * `in_bal_after_out` returns the input token pool balance required after
+    *   `out_amount` is removed from the output balance:
+    *   B_in * (B_out / (B_out - out_amount))^(W_out/W_in), or -1 if that overflows.
+    *
+    * Balances are rounded to nearest. Callers must ensure positive balances and
+    *   weights, and for `in_bal_after_out`, out_amount < out_bal.
+    */
+inline int64_t out_bal_after_in(int64_t in_bal, uint64_t w_in, int64_t out_bal, uint64_t w_out,
+                                int64_t in_amount) {
+  uint128 f = pow_ratio(uint64_t(in_bal), uint64_t(in_bal) + uint64_t(in_amount), w_in, w_out);
+  return int64_t(scale(uint64_t(out_bal), f));
+}
+
+inline int64_t in_bal_after_out(int64_t in_bal, uint64_t w_in, int64_t out_bal, uint64_t w_out,
+                                int64_t out_amount) {
+  uint128 f = pow_ratio(uint64_t(out_bal), uint64_t(out_bal - out_amount), w_out, w_in);
+  uint128 r = scale(uint64_t(in_bal), f);
+  return r > uint128(INT64_MAX) ? -1 : int64_t(r);
+}
+
+} // namespace oswaps_math
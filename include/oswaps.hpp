@@ -2,11 +2,16 @@
 #include <eosio/eosio.hpp>
 #include <eosio/crypto.hpp>
 #include <eosio/singleton.hpp>
+#include <eosio/system.hpp>
 #include <eosio/transaction.hpp>
 #include <algorithm>
+#include "txview.hpp"
+#include "fixedmath.hpp"
 
 using namespace eosio;
 using std::string;
+using oswaps_tx::tx_action;
+using oswaps_tx::tx_view;
    /**
     * The `oswaps` contract implements a token conversion service ("currency exchange") based on a
     *   multilateral token pool using the "balancer" invariant. The contract uses a "single sided"
@@ -15,10 +20,10 @@ using std::string;
     *   - add liquidity, e.g. insert some Token A into the pool
     *   - withdraw liquidity, e.g. extract some Token A from the pool
     *   - convert, e.g. change token A to Token B, delivered to a recipient
+    *   - exchange fees, credited to the liquidity providers of the incoming token
+    *   - liquidity metering, by a per-token rate limit on pool changes
     * The initial `oswaps` implementation is a Proof of Concept and lacks some functions
     *   including
-    *   - exchange fees
-    *   - liquidity metering
     *   - multichain operation
     *
     * Transfers into the oswaps contract proceed via a compound transaction containing two actions
@@ -59,21 +64,33 @@ using std::string;
 CONTRACT oswaps : public contract {
   public:
       using contract::contract;
+      ~oswaps();
 
       /**
           * The `reset` action executed by the oswaps contract account deletes all table data
+          *   in the contract scope, including LIQ token stats, erasing up to `max_rows`
+          *   rows per call. The first call removes the configuration; the action is
+          *   repeated until no reset is in progress, and `init` is refused until then.
+          *   The last token id survives for the next `init`, so that the LIQ symbols of
+          *   erased tokens never come back: balances of them which `resetacct` has not
+          *   erased stay stale, and `gc` collects them.
+          *
+          * @param max_rows - the most rows to erase
       */
-      ACTION reset();
+      ACTION reset(uint32_t max_rows);
  
       /**
-          * This action clears the `accounts` table for a particular account. All
-          * token balances in the account are erased.
+          * This action clears the `accounts` table for a particular account, then its
+          * LP fee checkpoints, then its internal deposits, erasing up to `max_rows`
+          * rows per call. All token balances in the account are erased; erased
+          * deposits are left to `reconcile` into the pool.
           *
           * @param account - account
+          * @param max_rows - the most rows to erase
           *
           * @pre Transaction must have the contract account owner authority 
           */
-         ACTION resetacct( const name& account );
+         ACTION resetacct( const name& account, uint32_t max_rows );
 
       /**
           * The one-time `init` action executed by the oswaps contract account records
@@ -103,12 +120,38 @@ CONTRACT oswaps : public contract {
           * @param symbol - the symbol of the affected token
       */
       ACTION unfreeze(name actor, uint64_t token_id, string symbol);
+
+      /**
+          * The `setfee` action executed by the manager sets the exchange fee charged on
+          *   incoming amounts of a token. The fee is kept out of the pool and shared
+          *   among holders of the token's LIQ tokens in proportion to their balances.
+          *
+          * @param actor - an account empowered to set the fee (manager account)
+          * @param token_id - a numerical token identifier in the asset table
+          * @param symbol - the symbol of the affected token
+          * @param fee - the fee as a fraction of the incoming amount, at most 0.1
+      */
+      ACTION setfee(name actor, uint64_t token_id, string symbol, float fee);
+
+      /**
+          * The `setlimit` action executed by the manager sets the rate limit of a token.
+          *   Withdrawals, liquidity additions and exchange outputs of the token draw from
+          *   a "token bucket" holding at most `capacity`, which refills continuously at
+          *   `refill` per second. An operation larger than the bucket's current level
+          *   fails. The bucket starts full; a zero capacity removes the limit.
+          *
+          * @param actor - an account empowered to set the limit (manager account)
+          * @param token_id - a numerical token identifier in the asset table
+          * @param capacity - the largest amount that may be drawn at once
+          * @param refill - the amount restored to the bucket per second
+      */
+      ACTION setlimit(name actor, uint64_t token_id, asset capacity, asset refill);
       
 
     typedef struct statusEntry {
       uint64_t token_id;
       asset balance;
-      float weight;
+      uint64_t weight;
     } statusEntry;
     typedef struct poolStatus {
       std::vector<statusEntry> status_entries;
@@ -117,16 +160,120 @@ CONTRACT oswaps : public contract {
       /**
           * The `querypool` action returns an array reporting on the balances and
           *   weights in the pool. This informations is intended to enable the caller
-          *   to compute the exchange rate for an upcoming transaction.
+          *   to compute the exchange rate for an upcoming transaction. Weights are
+          *   fixed point, with 1.0 represented as 1000000000.
           *
-          * @param token_id_list - an array of numerical token identifiers 
+          * @param token_id_list - an array of numerical token identifiers, or an empty
+          *   array for every token in the pool, in token id order. An empty array is
+          *   refused for a pool of more than 100 tokens, which is read with `querypage`.
       */
       [[eosio::action, eosio::read_only]] oswaps::poolStatus querypool(std::vector<uint64_t> token_id_list);
 
+    typedef struct poolPage {
+      std::vector<statusEntry> status_entries;
+      uint64_t more; // lower_bound of the next page, or 0 after the last page
+    } poolPage;
+
+      /**
+          * The `querypage` action reports balances and weights as `querypool` does,
+          *   for one page of the pool's tokens in token id order. Forgotten token ids
+          *   are simply absent, so a caller can sync the whole pool without knowing
+          *   its token ids, in a bounded number of calls each bounded in time.
+          *
+          * @param lower_bound - the least token id to report; 0 for the first page
+          * @param limit - the most tokens to report, at most 100; 0 for 100
+          *
+          * @result - the page, and the `lower_bound` of the next page
+      */
+      [[eosio::action, eosio::read_only]] oswaps::poolPage querypage(uint64_t lower_bound,
+                                                                     uint32_t limit);
+
+    typedef struct swapRequest {
+      uint64_t in_token_id;
+      uint64_t out_token_id;
+      asset amount;
+      bool exact_in;
+    } swapRequest;
+    typedef struct quoteEntry {
+      asset in_amount;
+      asset out_amount;
+      double spot_price;
+      double price_impact;
+      name status; // ok, frozen (either token) or ratelimited (the output token)
+    } quoteEntry;
+    typedef struct swapQuotes {
+      std::vector<quoteEntry> quote_entries;
+    } swapQuotes;
+
+      /**
+          * The `quote` action computes the outcome of a list of hypothetical swaps,
+          *   each evaluated independently against the current pool, using the same
+          *   computation as an `exprepfrom` or `exprepto` exchange.
+          *
+          * @param requests - an array of swaps; `amount` is the exact incoming amount
+          *   if `exact_in` is true, otherwise the exact outgoing amount
+          *
+          * @result - for each swap, the incoming and outgoing amounts, the spot price
+          *   after the swap (whole output tokens per whole input token), and the
+          *   price impact (fractional shortfall of the swap rate from the spot
+          *   price before the swap), with status `ok`. A swap refused because a token
+          *   is frozen, or because its output exceeds the output token's rate limit,
+          *   has status `frozen` or `ratelimited`, zero amounts and the spot price
+          *   before the swap.
+      */
+      [[eosio::action, eosio::read_only]] oswaps::swapQuotes quote(std::vector<swapRequest> requests);
+
+    typedef struct twapPrice {
+      uint32_t start;
+      uint32_t end;
+      double price;
+    } twapPrice;
+
+      /**
+          * The `querytwap` action returns the time-weighted average price of a token
+          *   between two times, from price accumulators which every change to a
+          *   token's balance or weight advances. The average is geometric, in whole
+          *   `quote_token_id` tokens per whole `token_id` token, from the pool's
+          *   balances and weights, excluding fees. Each token keeps an accumulator
+          *   checkpoint for every 5-minute period in which it changes, in a ring
+          *   covering the last 80 minutes. Times between checkpoints are
+          *   interpolated, so averages are exact between checkpoint times and any
+          *   time after a token's last change.
+          *
+          * @param token_id - the token priced
+          * @param quote_token_id - the token in which the price is expressed
+          * @param start - the start of the period, seconds since epoch
+          * @param end - the end of the period, seconds since epoch, or 0 for now
+          *
+          * @result - the period and the average price
+      */
+      [[eosio::action, eosio::read_only]] oswaps::twapPrice querytwap(uint64_t token_id,
+                                        uint64_t quote_token_id, uint32_t start, uint32_t end);
+
+    typedef struct feeEntry {
+      uint64_t token_id;
+      asset fees;
+    } feeEntry;
+    typedef struct accountFees {
+      std::vector<feeEntry> fee_entries;
+    } accountFees;
+
+      /**
+          * The `queryfees` action reports the exchange fees earned by a liquidity
+          *   provider and not yet claimed, including fees accrued since the
+          *   account's LIQ balance last changed.
+          *
+          * @param account - the liquidity provider
+          * @param token_id_list - an array of numerical token identifiers
+      */
+      [[eosio::action, eosio::read_only]] oswaps::accountFees queryfees(name account,
+                                               std::vector<uint64_t> token_id_list);
+
       /**
           * The `createasseta` creates an entry in the asset table for an
           *   antelope family token. It also creates a liquidity pool token
           *   LIQxx which will be issued in exchange for additions.
+          *   A contract and symbol can be registered only once.
           *   TBD: how to record IBC wrapped token contracts
           *
           * @param actor - an account empowered to set the specified parameter
@@ -142,8 +289,9 @@ CONTRACT oswaps : public contract {
               name actor, string chain, name contract, symbol_code symbol, string meta);
 
       /**
-          * The `forgetasset` action removes an entry in the asset table. This does
-          * not affect any token balance held by the contract.
+          * The `forgetasset` action removes an entry in the asset table and its LIQ
+          * token stats. This does not affect any token balance held by the contract.
+          * LIQ balances of the forgotten token are reclaimed by `gc`.
           *
           * @param actor - an account empowered remove the asset (manager account)
           * @param token_id - a numerical token identifier in the asset table
@@ -151,6 +299,43 @@ CONTRACT oswaps : public contract {
       */
       ACTION forgetasset(name actor, uint64_t token_id, string memo);
 
+      /**
+          * The `gc` action reclaims an account's LIQ balances, and fee checkpoints,
+          *   of forgotten assets, or of assets erased by `reset`. It visits up to `max_rows` balances per call,
+          *   resuming where the previous call for the same account stopped.
+          *   Anyone may collect.
+          *
+          * @param account - the account holding LIQ balances
+          * @param max_rows - the most balances to visit
+      */
+      ACTION gc(name account, uint32_t max_rows);
+
+      /**
+          * The `migrate` action moves up to `max_rows` asset table entries from the
+          *   original contract's `assetsa` table, which also held chain ids and
+          *   metadata, to the compact `tokensa` table with its `assetmeta` and `chains`
+          *   companions. The original contract read pool balances from the token
+          *   contracts, so each token's balance becomes the contract's holding of it;
+          *   fees and the rate limit start unset. Tokens must be migrated before they
+          *   can be used.
+          *
+          * @param actor - an account empowered to migrate (manager account)
+          * @param max_rows - the most entries to move
+      */
+      ACTION migrate(name actor, uint32_t max_rows);
+
+      /**
+          * The `reconcile` action re-synchronizes the pool balance recorded in the asset
+          *   table with the contract's actual balance on the token contract. Tokens
+          *   transferred to oswaps outside of an add-liquidity or exchange transaction
+          *   do not enter the pool (and do not move the exchange rate) until the
+          *   manager reconciles.
+          *
+          * @param actor - an account empowered to reconcile (manager account)
+          * @param token_id - a numerical token identifier in the asset table
+      */
+      ACTION reconcile(name actor, uint64_t token_id);
+
       /**
           * The `withdraw` action withdraws liquidity while simultaneously
           *   adjusting weight-fractions in the balancer invariant formula
@@ -158,8 +343,7 @@ CONTRACT oswaps : public contract {
           * which leaves the exchange rate unchanged. If the parameter is non-zero,
           * (i.e. price is being changed) the token will be frozen until it is
           * re-activated by the manager with an unfreeze action.
-          * [future: Token transfers occur through a rate-throttling queue which may
-          *    introduce delays]
+          * The amount is subject to the token's rate limit (see `setlimit`).
           * 
           * @param account - the account receiving the tokens
           * @param token_id - a numerical token identifier in the asset table
@@ -168,6 +352,174 @@ CONTRACT oswaps : public contract {
       */
       ACTION withdraw(name account, uint64_t token_id, string amount, float weight);
 
+      /**
+          * `withdraw2`, `addliqprep2`, `exprepfrom2` and `exprepto2` are the same as
+          *   the actions without the suffix, but take amounts as binary assets
+          *   instead of strings, so nothing is parsed on chain. The string actions
+          *   are kept for compatibility.
+      */
+      ACTION withdraw2(name account, uint64_t token_id, asset amount, float weight);
+
+      /**
+          * The `claimfees` action transfers the exchange fees earned by a liquidity
+          *   provider in a token to the provider's account.
+          *
+          * @param account - the liquidity provider
+          * @param token_id - a numerical token identifier in the asset table
+      */
+      ACTION claimfees(name account, uint64_t token_id);
+
+      /**
+          * The `swapint` action exchanges between an account's internal deposit
+          *   balances (see `ontransfer`), with no token transfers. Fees, rate limits
+          *   and event logging are as for any exchange.
+          *
+          * @param account - the account whose deposits are exchanged
+          * @param in_token_id - the token paid from deposits
+          * @param out_token_id - the token credited to deposits
+          * @param in_amount - the exact amount paid, including the fee
+          * @param min_out - the least acceptable output, in the smallest unit of the
+          *   output token
+      */
+      ACTION swapint(name account, uint64_t in_token_id, uint64_t out_token_id, asset in_amount,
+                     int64_t min_out);
+
+      /**
+          * The `depwithdraw` action transfers part of an account's internal deposit
+          *   balance of a token to the account.
+          *
+          * @param account - the account withdrawing
+          * @param token_id - a numerical token identifier in the asset table
+          * @param amount - the amount to withdraw
+      */
+      ACTION depwithdraw(name account, uint64_t token_id, asset amount);
+
+    typedef struct batchOp {
+      name op; // swap, addliq or withdraw
+      uint64_t token_id; // the input token of a swap
+      uint64_t out_token_id; // swaps only
+      asset amount; // the exact input of a swap, or the liquidity added or withdrawn
+      int64_t min_out; // swaps only, in the smallest unit of the output token
+      float weight; // liquidity only, the new balancer weight (or zero)
+    } batchOp;
+
+      /**
+          * The `batch` action runs a list of swaps, liquidity additions and liquidity
+          *   withdrawals for one account against in-memory copies of the asset rows,
+          *   keeping a running net amount of each token owed to or by the account.
+          *   Each operation behaves as its standalone counterpart (`swapint`,
+          *   `addliqprep2`, `withdraw2`), including fees, rate limits, event logging
+          *   and LIQ tokens, but each touched asset row is written once. At the end,
+          *   every net amount owed by the account is paid from its internal deposits
+          *   (see `ontransfer`) and every net amount owed to it is sent in one
+          *   transfer per token. Withdrawals require the manager's authority, as for
+          *   `withdraw2`, and liquidity additions a positive amount, as the transfer
+          *   following `addliqprep2` does.
+          *
+          * @param account - the account trading and providing liquidity
+          * @param ops - the operations, in order
+      */
+      ACTION batch(name account, std::vector<batchOp> ops);
+
+      /**
+          * The `withdrawq` action queues a withdrawal of liquidity which leaves the
+          *   exchange rate unchanged, as `withdraw2` with zero weight. Nothing moves
+          *   until a `crank` processes the request, which is then subject to the
+          *   balances and rate limit at that time. The manager pays the RAM of the
+          *   queue entry and of the account's fee checkpoint for the token.
+          *
+          * @param account - the account receiving the tokens
+          * @param token_id - a numerical token identifier in the asset table
+          * @param amount - the amount of asset to withdraw from pool
+      */
+      ACTION withdrawq(name account, uint64_t token_id, asset amount);
+
+      /**
+          * The `crank` action processes queued withdrawals in order, up to `max_items`
+          *   of them. LIQ tokens are burned directly and the withdrawals of each
+          *   account and token in the batch are paid in a single transfer. A request
+          *   which can no longer be met (insufficient LIQ or pool balance, a pool
+          *   balance so small that the token's weight would round to zero, or an
+          *   erased fee checkpoint) is dropped;
+          *   a request exceeding the token's rate limit stops the batch, leaving it
+          *   and later requests queued. Anyone may crank.
+          *
+          * @param max_items - the most requests to process
+      */
+      ACTION crank(uint32_t max_items);
+
+      /**
+          * The `setbatch` action executed by the manager enables batch swaps (see
+          *   `ontransfer`) with settlement windows of `window` seconds, or disables
+          *   new batch swaps if `window` is zero.
+          *
+          * @param actor - an account empowered to configure batching (manager account)
+          * @param window - the length of a settlement window in seconds
+      */
+      ACTION setbatch(name actor, uint32_t window);
+
+      /**
+          * The `settle` action clears the batch swap intents of all closed windows.
+          *   The intents for each pair of tokens are cleared together at a uniform
+          *   price: opposing flows are matched against each other and only the net
+          *   flow is exchanged with the pool, at the price which makes the pool's
+          *   exchange rate equal to the price paid by every intent. Exchange fees
+          *   apply only to the net flow. Payouts are made in one transfer per
+          *   recipient and token. An intent whose output would fall below its
+          *   minimum is refunded and the pair is cleared again without it.
+          *   Intents are settled in order of arrival, up to `max_items` of them;
+          *   a later call settles the rest. Anyone may settle.
+          *
+          * @param max_items - the most intents to settle
+      */
+      ACTION settle(uint32_t max_items);
+
+    typedef struct swapEvent {
+      uint64_t seq; // orders all oswaps events
+      name sender;
+      name recipient;
+      uint64_t in_token_id;
+      uint64_t out_token_id;
+      int64_t in_amount; // including the fee
+      int64_t out_amount;
+      int64_t fee;
+      int64_t in_bal_before;
+      int64_t in_bal_after;
+      int64_t out_bal_before;
+      int64_t out_bal_after;
+      uint64_t in_weight;
+      uint64_t out_weight;
+    } swapEvent;
+    typedef struct liqEvent {
+      uint64_t seq; // orders all oswaps events
+      name account;
+      uint64_t token_id;
+      int64_t amount; // added to the pool if positive, withdrawn if negative
+      int64_t bal_before;
+      int64_t bal_after;
+      uint64_t weight_before;
+      uint64_t weight_after;
+    } liqEvent;
+
+      /**
+          * The `logswap` action does nothing. The contract sends it inline for every
+          *   exchange with the pool, so that indexers can read exchanges from action
+          *   traces as fixed-size records. A route logs each leg; a batch settlement
+          *   logs the net exchange of each pair, with the contract as sender and
+          *   recipient. Balances are in token units and exclude unclaimed fees.
+          *
+          * @param event - the exchange
+      */
+      ACTION logswap(swapEvent event);
+
+      /**
+          * The `logliq` action does nothing. The contract sends it inline for every
+          *   liquidity addition and withdrawal, as `logswap` does for exchanges.
+          *
+          * @param event - the change in liquidity
+      */
+      ACTION logliq(liqEvent event);
+
       /**
           * The `addliqprep` action adds liquidity while simultaneously
           *   adjusting weight-fractions in the balancer invariant formula
@@ -175,8 +527,7 @@ CONTRACT oswaps : public contract {
           * which leaves the exchange rate unchanged. If the parameter is non-zero,
           * (i.e. price is being changed) the token will be frozen until it is
           * re-activated by the manager with an unfreeze action.
-          * [future: Token transfers occur through a rate-throttling queue which may
-          *    introduce delays]
+          * The amount is subject to the token's rate limit (see `setlimit`).
           * 
           * @param account - the account sourcing the tokens
           * @param token_id - a numerical token identifier in the asset table
@@ -185,6 +536,8 @@ CONTRACT oswaps : public contract {
       */
       ACTION addliqprep(name account, uint64_t token_id,
                         string amount, float weight);
+      ACTION addliqprep2(name account, uint64_t token_id,
+                         asset amount, float weight);
 
       /**
           * The `exprepfrom` and `exprepto` actions are functions describing a conversion
@@ -207,12 +560,19 @@ CONTRACT oswaps : public contract {
           * @param out_token_id - a numerical token identifier for the outgoing asset
           * @param in_amount - the incoming amount (quantity, symbol) 
           * @param memo
-          *
+          * @param min_out - (`exprepfrom2` only, optional) the minimum acceptable outgoing
+          *   amount (quantity, symbol)
+          * @param expires - (`exprepfrom2` only, optional) the last time at which the
+          *   exchange may execute; zero for none
           *
       */
       ACTION exprepfrom(
            name sender, name recipient, uint64_t in_token_id, uint64_t out_token_id,
            string in_amount, string memo);
+      ACTION exprepfrom2(
+           name sender, name recipient, uint64_t in_token_id, uint64_t out_token_id,
+           asset in_amount, string memo, binary_extension<asset> min_out,
+           binary_extension<time_point_sec> expires);
 
       /**
           * In the `exprepto` action call, the outgoing amount is specified and the incoming
@@ -224,11 +584,41 @@ CONTRACT oswaps : public contract {
           * @param out_token_id - a numerical token identifier for the outgoing asset
           * @param out_amount - the outgoing amount (quantity, symbol)
           * @param memo
+          * @param max_in - (`exprepto2` only, optional) the maximum acceptable incoming
+          *   amount (quantity, symbol); any transfer in beyond the amount used is refunded
+          * @param expires - (`exprepto2` only, optional) the last time at which the
+          *   exchange may execute; zero for none
           *
       */
       ACTION exprepto(
            name sender, name recipient, uint64_t in_token_id, uint64_t out_token_id,
            string out_amount, string memo);
+      ACTION exprepto2(
+           name sender, name recipient, uint64_t in_token_id, uint64_t out_token_id,
+           asset out_amount, string memo, binary_extension<asset> max_in,
+           binary_extension<time_point_sec> expires);
+
+      /**
+          * The `exroute` action describes a multi-hop conversion along a path of tokens,
+          *   e.g. token A to token C through token B. Each leg is an exact-input
+          *   exchange whose output is the input of the next leg. Intermediate tokens
+          *   stay in the pool; only the final output is transferred to the recipient.
+          * 
+          * @param sender - the account sourcing tokens to the transaction
+          * @param recipient - the account receiving tokens from the transaction
+          * @param path - numerical token identifiers, from the incoming asset to the
+          *   outgoing asset
+          * @param in_amount - the incoming amount (quantity, symbol)
+          * @param min_out - the minimum acceptable outgoing amount (quantity, symbol)
+          * @param memo
+          * @param expires - (optional) the last time at which the exchange may execute;
+          *   zero for none
+          *
+      */
+      ACTION exroute(
+           name sender, name recipient, std::vector<uint64_t> path,
+           asset in_amount, asset min_out, string memo,
+           binary_extension<time_point_sec> expires);
 
            
       /**
@@ -267,6 +657,24 @@ CONTRACT oswaps : public contract {
           * If no recognized action preceded the transfer, the token is
           *   transferred into the contract account's balance.
           *
+          * Alternatively a plain transfer may request a swap in its memo, with no
+          *   prep action and no transaction introspection:
+          *     #F,<out_token_id>,<recipient>,<min_out>  exchange the whole quantity
+          *     #T,<out_token_id>,<recipient>,<out>      buy exactly <out>, refunding
+          *                                              any unused input
+          *     #B,<out_token_id>,<recipient>,<min_out>  escrow the quantity as a batch
+          *                                              swap intent (see `settle`), of
+          *                                              at least 1/10000 of the input
+          *                                              token's pool balance
+          *     #D[,<recipient>]                         credit the quantity to an internal
+          *                                              deposit balance (see `swapint`); a
+          *                                              recipient other than the sender
+          *                                              must already hold a deposit of
+          *                                              the token
+          *   Amounts are integers in the smallest unit of the output token. An empty
+          *   recipient means the sender. Memos beginning with '#' are reserved for
+          *   these requests and are rejected if malformed.
+          *
           * @param from - token sender
           * @param to - token recipient
           * @param quantity - the quantity transferred (amount and symbol)
@@ -285,6 +693,13 @@ CONTRACT oswaps : public contract {
       float weight;
       EOSLIB_SERIALIZE( addliqprep_params, (account)(token_id)(amount)(weight) )
     };
+    struct addliqprep2_params {
+      name account;
+      uint64_t token_id;
+      asset amount;
+      float weight;
+      EOSLIB_SERIALIZE( addliqprep2_params, (account)(token_id)(amount)(weight) )
+    };
     struct exprepfrom_params {
       name sender;
       name recipient;
@@ -295,6 +710,18 @@ CONTRACT oswaps : public contract {
       EOSLIB_SERIALIZE( exprepfrom_params,
         (sender)(recipient)(in_token_id)(out_token_id)(in_amount)(memo) )
     };
+    struct exprepfrom2_params {
+      name sender;
+      name recipient;
+      uint64_t in_token_id;
+      uint64_t out_token_id;
+      asset in_amount;
+      string memo;
+      binary_extension<asset> min_out;
+      binary_extension<time_point_sec> expires;
+      EOSLIB_SERIALIZE( exprepfrom2_params,
+        (sender)(recipient)(in_token_id)(out_token_id)(in_amount)(memo)(min_out)(expires) )
+    };
     struct exprepto_params {
       name sender;
       name recipient;
@@ -306,6 +733,28 @@ CONTRACT oswaps : public contract {
         (sender)(recipient)(in_token_id)(out_token_id)(out_amount)(memo) )
 
     };
+    struct exprepto2_params {
+      name sender;
+      name recipient;
+      uint64_t in_token_id;
+      uint64_t out_token_id;
+      asset out_amount;
+      string memo;
+      binary_extension<asset> max_in;
+      binary_extension<time_point_sec> expires;
+      EOSLIB_SERIALIZE( exprepto2_params,
+        (sender)(recipient)(in_token_id)(out_token_id)(out_amount)(memo)(max_in)(expires) )
+    };
+    struct exroute_params {
+      name sender;
+      name recipient;
+      std::vector<uint64_t> path;
+      asset in_amount;
+      asset min_out;
+      string memo;
+      EOSLIB_SERIALIZE( exroute_params,
+        (sender)(recipient)(path)(in_amount)(min_out)(memo) )
+    };
     struct transfer_params {
       name from;
       name to;
@@ -336,12 +785,82 @@ CONTRACT oswaps : public contract {
       TABLE config { // singleton, scoped by contract account name
         name manager;
         checksum256 chain_id;
-        uint64_t last_token_id;
-        bool withdraw_flag;
+        uint64_t last_token_id = 0;
+        bool withdraw_flag = false;
       } config_row;
 
-      // types of antelope tokens
+      // rate limit on the pool changes of a token, refilled continuously
+      struct token_bucket {
+        int64_t capacity; // zero for no limit
+        int64_t refill; // per second
+        int64_t level;
+        uint32_t updated; // seconds since epoch
+
+        // the amount that may be drawn now
+        int64_t available() const {
+          if (capacity == 0) {
+            return INT64_MAX;
+          }
+          __int128 refilled = level + __int128(refill)
+            * (current_time_point().sec_since_epoch() - updated);
+          return refilled < capacity ? int64_t(refilled) : capacity;
+        }
+        void draw(int64_t amount, symbol_code sym) {
+          if (capacity == 0) {
+            return;
+          }
+          level = available();
+          updated = current_time_point().sec_since_epoch();
+          check(amount <= level, sym.to_string() + " rate limit exceeded, retry later");
+          level -= amount;
+        }
+      };
+
+      // key of the `bytoken` index, unique to a token contract and symbol
+      static uint128_t token_key(name contract, symbol_code symbol) {
+        return (uint128_t(contract.value) << 64) | symbol.raw();
+      }
+
+      // chains of registered tokens
+      TABLE chain { // single table, scoped by contract account name
+        uint64_t ordinal;
+        checksum256 chain_id;
+
+        uint64_t primary_key() const { return ordinal; }
+      };
+
+      // types of antelope tokens, holding only what exchanges use; fixed size
       TABLE assettypea { // single table, scoped by contract account name
+        uint64_t token_id;
+        uint16_t chain; // ordinal in the chains table
+        name contract_name;
+        symbol_code symbol;
+        bool active;
+        uint64_t weight; // balancer weight, fixed point with 1.0 = 1000000000
+        asset balance; // pool balance tracked by oswaps, with token precision
+        eosio::symbol liq_symbol; // liquidity token issued for this asset
+        uint64_t fee_rate; // exchange fee on input, fixed point with 1.0 = 1000000000
+        uint128_t fee_growth; // fees per LIQ unit since creation, fixed point 64.64
+        asset fees; // fees held for liquidity providers, not part of the pool balance
+        token_bucket limit;
+        asset deposits; // internal balances of accounts, not part of the pool balance
+        uint128_t price_cum; // sum over seconds of log2(balance/weight), fixed point 64.64, wrapping
+        uint32_t price_updated; // when price_cum was last advanced, seconds since epoch
+        
+        uint64_t primary_key() const { return token_id; }
+        uint128_t by_token() const { return token_key(contract_name, symbol); }
+      };
+
+      // asset metadata, if not empty
+      TABLE assetmeta { // single table, scoped by contract account name
+        uint64_t token_id;
+        string metadata;
+
+        uint64_t primary_key() const { return token_id; }
+      };
+
+      // asset rows of the original contract, read by `migrate`
+      TABLE legacyassettypea {
         uint64_t token_id;
         checksum256 chain_code;
         name contract_name;
@@ -349,28 +868,153 @@ CONTRACT oswaps : public contract {
         bool active;
         string metadata;
         float weight;
-        
+
         uint64_t primary_key() const { return token_id; }
         checksum256 by_chain() const { return chain_code; }
       };
      
-      // for transient storage of prep action for immediately following transfer
-      TABLE txtemp { // singleton, scoped by contract account name
-        std::string txdata;
+      // fee checkpoint of a liquidity provider
+      TABLE lpfee { // scoped by account name
+        uint64_t token_id;
+        uint128_t fee_growth; // asset fee_growth when fees were last settled
+        int64_t owed; // settled and unclaimed fees, in token units
+
+        uint64_t primary_key() const { return token_id; }
+      };
 
-        //uint64_t primary_key() const { return 0; } // single row
+      // an asset's price accumulator at some time
+      struct price_checkpoint {
+        uint32_t time; // seconds since epoch, zero if unused
+        uint128_t price_cum;
+      };
+
+      // price accumulator checkpoints of an asset, in a ring indexed by time
+      TABLE pricering { // single table, scoped by contract account name
+        uint64_t token_id;
+        std::vector<price_checkpoint> ring;
+
+        uint64_t primary_key() const { return token_id; }
+      };
+
+      // internal balances of an account, funded by "#D" transfers
+      TABLE deposit { // scoped by account name
+        uint64_t token_id;
+        asset balance;
+
+        uint64_t primary_key() const { return token_id; }
+      };
+
+      // queued withdrawals, processed by `crank`
+      TABLE withdrawal { // single table, scoped by contract account name
+        uint64_t id;
+        name account;
+        uint64_t token_id;
+        asset amount;
+
+        uint64_t primary_key() const { return id; }
+      };
+
+      // batch swap configuration
+      TABLE batchconf { // singleton, scoped by contract account name
+        uint32_t window = 0; // seconds, zero when batch swaps are disabled
+      } batchconf_row;
+
+      // progress of resumable cleanup actions, absent when none is in progress
+      TABLE cleanup { // singleton, scoped by contract account name
+        uint8_t reset_phase = 0; // next table erased by `reset`, zero when idle
+        name gc_account; // account whose balances `gc` is visiting
+        uint64_t gc_cursor = 0; // symbol code of the next balance visited
+        uint64_t last_token_id = 0; // kept by `reset` for the next `init`
+      } cleanup_row;
+
+      // sequence of logged events
+      TABLE eventseq { // singleton, scoped by contract account name
+        uint64_t last = 0; // seq of the last `logswap` or `logliq` event
+      } eventseq_row;
+
+      // escrowed batch swap intents, in order of arrival
+      TABLE intent { // single table, scoped by contract account name
+        uint64_t id;
+        uint32_t closes; // end of the settlement window, seconds since epoch
+        name sender;
+        name recipient;
+        name in_contract;
+        uint64_t in_token_id;
+        uint64_t out_token_id;
+        asset in_amount;
+        int64_t min_out;
+
+        uint64_t primary_key() const { return id; }
       };
 
       typedef eosio::singleton< "configs"_n, config > configs;
-      typedef eosio::multi_index<"assetsa"_n, assettypea, indexed_by
+      typedef eosio::singleton< "batchconfs"_n, batchconf > batchconfs;
+      typedef eosio::singleton< "cleanups"_n, cleanup > cleanups;
+      typedef eosio::singleton< "eventseqs"_n, eventseq > eventseqs;
+      typedef eosio::multi_index<"chains"_n, chain> chains;
+      typedef eosio::multi_index<"tokensa"_n, assettypea, indexed_by
+               < "bytoken"_n,
+                 const_mem_fun<assettypea, uint128_t, &assettypea::by_token > >
+               > tokensa;
+      typedef eosio::multi_index<"assetmeta"_n, assetmeta> assetmetas;
+      // declares the legacy index so that `migrate` erases its entries too
+      typedef eosio::multi_index<"assetsa"_n, legacyassettypea, indexed_by
                < "bychain"_n,
-                 const_mem_fun<assettypea, checksum256, &assettypea::by_chain > >
-               > assetsa;
-      typedef eosio::singleton< "tx"_n, txtemp >  txx;
+                 const_mem_fun<legacyassettypea, checksum256, &legacyassettypea::by_chain > >
+               > legacyassetsa;
+      typedef eosio::multi_index<"lpfees"_n, lpfee> lpfees;
+      typedef eosio::multi_index<"deposits"_n, deposit> deposits;
+      typedef eosio::multi_index<"pricerings"_n, pricering> pricerings;
+      typedef eosio::multi_index<"withdrawals"_n, withdrawal> withdrawals;
+      typedef eosio::multi_index<"intents"_n, intent> intents;
+
+      struct swap_result {
+        int64_t in_amount; // including the fee
+        int64_t out_amount;
+        int64_t fee;
+        int64_t in_bal_after;
+        int64_t out_bal_after;
+      };
+      swap_result compute_swap(const assettypea& ain, const assettypea& aout,
+                               int64_t amount, bool exact_in);
 
+      void log_swap(name sender, name recipient, const assettypea& ain, const assettypea& aout,
+                    const swap_result& sw);
+      void log_liq(name account, const assettypea& before, int64_t bal_after, uint64_t weight_after);
+      uint64_t next_event_seq();
+      // event sequence of the running action, read by its first event and saved when the
+      //   action ends, so that a multi-hop swap writes the singleton once
+      eventseq event_seq;
+      bool event_seq_loaded = false;
+      void observe(assettypea& a);
+      uint128_t price_cum_at(const assettypea& a, uint32_t time);
+      void accrue_fee(assettypea& a, int64_t fee);
+      int64_t earned_fees(name owner, const assettypea& a);
+      void settle_fees(name owner, const assettypea& a, name ram_payer);
       void sub_balance( const name& owner, const asset& value );
       void add_balance( const name& owner, const asset& value, const name& ram_payer );
-      void save_transaction(name entry, uint64_t token_id);
+      void check_prep_transaction(name entry, uint64_t token_id);
+      uint16_t chain_ordinal(const checksum256& chain_id);
+      bool reset_step(uint8_t phase, uint32_t& budget);
+      void save_cleanup(const cleanup& state);
+      void memo_swap(name from, asset quantity, const string& memo);
+      void memo_deposit(name from, asset quantity, const string& memo);
+      void add_deposit(name account, const assettypea& a, int64_t amount, name ram_payer);
+      void sub_deposit(name account, const assettypea& a, int64_t amount);
+      void send_exchange(name out_contract, name recipient, asset out_qty,
+                         const string& memo, name sender, asset in_qty, int64_t in_surplus);
+
+      struct payment {
+        name contract;
+        name to;
+        asset quantity;
+      };
+      static void add_payment(std::vector<payment>& payments, name contract, name to,
+                              asset quantity);
+      int64_t net_batch_flow(const assettypea& a, const assettypea& b,
+                             int64_t a_total, int64_t b_total);
+      void clear_pair(assettypea& x, assettypea& y, std::vector<intent>& batch,
+                      std::vector<payment>& payments);
 };
 
 
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+   /**
+    * `tx_view` is a read-only view over a packed (serialized) transaction, as returned
+    *   by `read_transaction`. The constructor walks the bytes in place, skipping the
+    *   header, the context-free actions and all but the final two actions by their
+    *   varint lengths. Nothing is copied or allocated, so the cost of validating an
+    *   oswaps prep/transfer pair does not grow with the data carried by any actions
+    *   a wallet may have prepended to the transaction.
+    *
+    * The final two actions are exposed as `tx_action` spans which point into the
+    *   caller's buffer; the buffer must outlive the view.
+    *
+    * The header has no eosio dependencies so that it may be exercised natively.
+    */
+
+namespace oswaps_tx {
+
+struct tx_action {
+  uint64_t    account = 0; // eosio::name value
+  uint64_t    name = 0;    // eosio::name value
+  const char* data = nullptr;
+  uint32_t    size = 0;
+};
+
+class tx_view {
+  public:
+    tx_view(const char* buffer, size_t size)
+      : pos(buffer), end(buffer + size) {
+      // transaction_header: expiration, ref_block_num, ref_block_prefix
+      skip(4 + 2 + 4);
+      read_varuint32(); // max_net_usage_words
+      skip(1);          // max_cpu_usage_ms
+      read_varuint32(); // delay_sec
+      uint32_t cfa_count = read_varuint32();
+      for (uint32_t i = 0; ok && i < cfa_count; ++i) {
+        tx_action ignored;
+        read_action(ignored);
+      }
+      count = read_varuint32();
+      for (uint32_t i = 0; ok && i < count; ++i) {
+        // keep the two most recent actions in alternating slots
+        read_action(slots[i & 1]);
+      }
+      // transaction_extensions are not inspected
+    }
+
+    bool valid() const { return ok; }
+    uint32_t action_count() const { return count; }
+
+    // final action of the transaction; requires action_count() >= 1
+    const tx_action& last() const { return slots[(count - 1) & 1]; }
+    // next-to-last action of the transaction; requires action_count() >= 2
+    const tx_action& next_to_last() const { return slots[count & 1]; }
+
+  private:
+    const char* pos;
+    const char* end;
+    bool        ok = true;
+    uint32_t    count = 0;
+    tx_action   slots[2];
+
+    void skip(size_t n) {
+      if (!ok || size_t(end - pos) < n) {
+        ok = false;
+        return;
+      }
+      pos += n;
+    }
+
+    uint64_t read_uint64() {
+      uint64_t v = 0;
+      if (!ok || end - pos < 8) {
+        ok = false;
+        return 0;
+      }
+      for (int i = 0; i < 8; ++i) {
+        v |= uint64_t(uint8_t(pos[i])) << (8 * i);
+      }
+      pos += 8;
+      return v;
+    }
+
+    uint32_t read_varuint32() {
+      uint64_t v = 0;
+      uint8_t  shift = 0;
+      while (ok) {
+        if (pos == end || shift > 28) {
+          ok = false;
+          break;
+        }
+        uint8_t b = uint8_t(*pos++);
+        v |= uint64_t(b & 0x7f) << shift;
+        shift += 7;
+        if (!(b & 0x80)) {
+          break;
+        }
+      }
+      return ok ? uint32_t(v) : 0;
+    }
+
+    void read_action(tx_action& a) {
+      a.account = read_uint64();
+      a.name = read_uint64();
+      uint32_t auth_count = read_varuint32();
+      // each permission_level is two names
+      if (ok && auth_count > size_t(end - pos) / 16) {
+        ok = false;
+      }
+      skip(size_t(auth_count) * 16);
+      a.size = read_varuint32();
+      a.data = pos;
+      skip(a.size);
+    }
+};
+
+} // namespace oswaps_tx
@@ -9,100 +9,346 @@ const checksum256 telos_chain_id = checksum256::make_from_word_sequence<uint64_t
   0xbe0e1284a2f59699u,
   0x054a018f743b1d11u );
 
-uint64_t amount_from(symbol sym, string qty) { 
-  int sp = qty.find(' ');
-  check(sym.code().to_string() == qty.substr(sp+1), "mismatched symbol");
-  size_t dp;
-  uint64_t rv = std::stol(qty, &dp)*pow(10,sym.precision());
-  if(qty.at(dp)=='.') {
-    uint64_t f = std::stol(qty.substr(dp+1));
-    int decimals = sp-dp-1;
-    check(decimals <= sym.precision(), "too many decimals");
-    for(int i=decimals; i<sym.precision(); ++i) {
-      f *= 10;
-    }
-    rv += f;
+// fixed-point scale of balancer weights in the asset table
+const uint64_t weight_one = 1000000000;
+
+uint64_t weight_from(float weight) {
+  check(weight >= 0.0 && weight < 1.0e9, "weight out of range");
+  return uint64_t(llround(double(weight) * weight_one));
+}
+
+// weight * num / den, without intermediate overflow
+uint64_t scale_weight(uint64_t weight, uint64_t num, uint64_t den) {
+  oswaps_math::uint128 w = oswaps_math::uint128(weight) * num / den;
+  check(w > 0 && w <= UINT64_MAX, "weight out of range");
+  return uint64_t(w);
+}
+
+// a prep action's deadline; zero or absent means none
+void check_deadline(const binary_extension<time_point_sec>& expires) {
+  uint32_t deadline = expires.value_or().sec_since_epoch();
+  check(deadline == 0 || current_time_point().sec_since_epoch() <= deadline, "swap expired");
+}
+
+// intents are escrowed at the contract's RAM expense (a notification cannot bill the
+//   sender), so each must be at least this fraction of its input token's pool balance
+const int64_t intent_min_fraction = 10000;
+
+// the most tokens querypage reports in one call
+const uint32_t page_max_rows = 100;
+
+// price accumulator checkpoints are taken at most once per interval, in a ring of slots
+const uint32_t checkpoint_interval = 300;
+const uint64_t checkpoint_slots = 16;
+
+// log2(balance / weight) in 64.64, two's complement; zero without a price
+oswaps_math::uint128 log_price(int64_t balance, uint64_t weight) {
+  if (balance <= 0 || weight == 0) {
+    return 0;
+  }
+  if (uint64_t(balance) >= weight) {
+    return oswaps_math::log2(oswaps_math::ratio(balance, weight));
   }
+  return -oswaps_math::log2(oswaps_math::ratio(weight, balance));
+}
+
+// parses e.g. "12.5 ABC" for a symbol of precision 4 as 125000; integer only
+uint64_t amount_from(symbol sym, const string& qty) {
+  size_t sp = qty.find(' ');
+  check(sp != string::npos && sym.code().to_string() == qty.substr(sp+1), "mismatched symbol");
+  uint64_t rv = 0;
+  int digits = 0;
+  int decimals = -1;
+  for (size_t i = 0; i < sp; ++i) {
+    if (qty[i] == '.' && decimals < 0) {
+      decimals = 0;
+      continue;
+    }
+    check(qty[i] >= '0' && qty[i] <= '9', "malformed amount");
+    check(++digits <= 18, "amount out of range");
+    rv = rv*10 + (qty[i] - '0');
+    if (decimals >= 0) {
+      ++decimals;
+    }
+  }
+  check(digits > 0, "malformed amount");
+  check(decimals <= sym.precision(), "too many decimals");
+  for (int i = decimals < 0 ? 0 : decimals; i < sym.precision(); ++i) {
+    rv *= 10;
+  }
+  check(rv < (uint64_t(1) << 62), "amount out of range");
   return rv;
 }
 
-string sym_from_id(uint64_t token_id, string prefix) {
-  if (token_id < 26) {
-    return prefix + string(1, 'A' + token_id);
-  } else {
-    prefix = sym_from_id(token_id/26 - 1, prefix);
-    return sym_from_id(token_id%26, prefix);
+// unsigned decimal integer, digits only
+uint64_t uint_from(const string& s) {
+  check(!s.empty() && s.size() <= 19, "malformed integer");
+  uint64_t rv = 0;
+  for (char c : s) {
+    check(c >= '0' && c <= '9', "malformed integer");
+    rv = rv*10 + (c - '0');
   }
+  return rv;
 }
 
-void oswaps::save_transaction(name entry, uint64_t token_id) {
-  auto size = transaction_size();
-  //printf("saved tx, size %ld ", size);
-  char *   buffer = (char *)(512 < size ? malloc(size) : alloca(size));
+// raw symbol code of the liquidity token for `token_id`: "LIQ" followed by the
+//   id in bijective base 26 (0 -> LIQA, 25 -> LIQZ, 26 -> LIQAA, ...), or 0 if the
+//   code would exceed 7 characters
+constexpr uint64_t liq_code_raw(uint64_t token_id) {
+  uint64_t raw = uint64_t('L') | uint64_t('I') << 8 | uint64_t('Q') << 16;
+  char letters[4] = {};
+  int n = 0;
+  while (true) {
+    if (n == 4) {
+      return 0;
+    }
+    letters[n++] = char('A' + token_id % 26);
+    if (token_id < 26) {
+      break;
+    }
+    token_id = token_id/26 - 1;
+  }
+  for (int i = 0; i < n; ++i) {
+    raw |= uint64_t(letters[n - 1 - i]) << (8 * (3 + i));
+  }
+  return raw;
+}
+static_assert(liq_code_raw(1) == (uint64_t('L') | uint64_t('I') << 8 | uint64_t('Q') << 16
+                                  | uint64_t('B') << 24), "LIQB");
+static_assert(liq_code_raw(27) == (uint64_t('L') | uint64_t('I') << 8 | uint64_t('Q') << 16
+                                   | uint64_t('A') << 24 | uint64_t('B') << 32), "LIQAB");
+
+// inverse of liq_code_raw
+constexpr uint64_t liq_token_id(uint64_t liq_raw) {
+  uint64_t token_id = 0;
+  for (int i = 3; i < 7 && (liq_raw >> (8 * i)) & 0xff; ++i) {
+    uint64_t letter = ((liq_raw >> (8 * i)) & 0xff) - 'A';
+    token_id = i == 3 ? letter : (token_id + 1)*26 + letter;
+  }
+  return token_id;
+}
+static_assert(liq_token_id(liq_code_raw(1)) == 1 && liq_token_id(liq_code_raw(27)) == 27
+              && liq_token_id(liq_code_raw(18277)) == 18277, "liq_token_id");
+
+// `buffer` must hold transaction_size() bytes and outlive the returned view
+tx_view read_trx(char * buffer, size_t size) {
   uint32_t read   = read_transaction(buffer, size);
   check(size == read, "read_transaction failed");
-  transaction trx = unpack<transaction>(buffer, size);  
-  // validation on trx.actions
+  tx_view trx(buffer, size);
+  check(trx.valid(), "malformed transaction");
+  return trx;
+}
+
+// oswaps actions which prepare the transfer following them in a transaction
+bool is_prep_action(name action_name) {
+  return action_name == "addliqprep"_n || action_name == "addliqprep2"_n
+    || action_name == "exprepfrom"_n || action_name == "exprepfrom2"_n
+    || action_name == "exprepto"_n || action_name == "exprepto2"_n
+    || action_name == "exroute"_n;
+}
+
+void oswaps::check_prep_transaction(name entry, uint64_t token_id) {
+  auto size = transaction_size();
+  char *   buffer = (char *)(512 < size ? malloc(size) : alloca(size));
+  tx_view trx = read_trx(buffer, size);
+  // validation on trx actions
   //   check that the last action transfers the right token to oswaps
   //   check that the next-to-last action is oswaps `entry` action
-  assetsa assettable(get_self(), get_self().value);
+  // nothing is saved here; `ontransfer` reads the transaction again for itself,
+  //   so a swap does no transient table I/O
+  check(trx.action_count() >= 2, "malformed oswaps trx, <2 actions");
+  tokensa assettable(get_self(), get_self().value);
   auto a = assettable.require_find(token_id, "unrecog token id");  
-  auto final_action = trx.actions.back();
-  check(final_action.name == "transfer"_n,
+  const tx_action& final_action = trx.last();
+  check(name(final_action.name) == "transfer"_n,
     "final action must be token transfer");
-  transfer_params tp = unpack<transfer_params>(final_action.data.data(), final_action.data.size());
+  transfer_params tp = unpack<transfer_params>(final_action.data, final_action.size);
   check(tp.to==get_self() && tp.quantity.symbol.code()==a->symbol
-    && final_action.account == a->contract_name,
+    && name(final_action.account) == a->contract_name,
     "token transfer parameters don't match prep");
-  action should_be_this_action = *(trx.actions.rbegin()+1);
-  check(should_be_this_action.name == entry
-    && should_be_this_action.account == get_self(),
+  const tx_action& should_be_this_action = trx.next_to_last();
+  check(name(should_be_this_action.name) == entry
+    && name(should_be_this_action.account) == get_self(),
     "prep action must be next-to-last in transaction ");
-  // save serialized transaction to txx singleton
-  std::string data(buffer, size);
-  txx txset(get_self(), get_self().value);
-  if (txset.exists()) {
-    print("replacing unexpected saved transaction");
-  }  
-  txtemp tx;
-  tx.txdata = data;
-  txset.set(tx, get_self());
-  return;
-
 }
   
-void oswaps::reset() {
+// tables erased by `reset`, in order
+enum reset_phase : uint8_t {
+  reset_idle, reset_tokens, reset_legacy, reset_meta, reset_chains, reset_withdrawals,
+  reset_intents, reset_batchconf, reset_pricerings, reset_done
+};
+
+// erases rows from the front of `tbl` while `budget` lasts, returning whether it is empty
+template<typename T>
+bool erase_rows(T&& tbl, uint32_t& budget) {
+  auto itr = tbl.begin();
+  while (itr != tbl.end() && budget > 0) {
+    itr = tbl.erase(itr);
+    --budget;
+  }
+  return itr == tbl.end();
+}
+
+void oswaps::reset(uint32_t max_rows) {
   require_auth2(get_self().value, "owner"_n.value);
-  {
-    assetsa tbl(get_self(), get_self().value);
-    auto itr = tbl.begin();
-    while (itr != tbl.end()) {
-      itr = tbl.erase(itr);
+  check(max_rows > 0, "max_rows must be positive");
+  cleanups cleanupset(get_self(), get_self().value);
+  auto state = cleanupset.get_or_default(cleanup_row);
+  if (state.reset_phase == reset_idle) {
+    // nothing else runs on a partly erased contract
+    configs configset(get_self(), get_self().value);
+    if(configset.exists()) {
+      // token ids continue after the reset, or stale LIQ balances would come back to life
+      state.last_token_id = std::max(state.last_token_id, configset.get().last_token_id);
+      configset.remove();
     }
-    // TODO destroy LIQ tokens
+    state.reset_phase = reset_tokens;
   }
-  configs configset(get_self(), get_self().value);
-  if(configset.exists()) { configset.remove(); }
+  uint32_t budget = max_rows;
+  while (state.reset_phase != reset_idle && reset_step(state.reset_phase, budget)) {
+    state.reset_phase = state.reset_phase + 1 == reset_done ? reset_idle : state.reset_phase + 1;
+  }
+  save_cleanup(state);
+}
+
+// erases rows of one `reset` phase while `budget` lasts, returning whether the phase is done
+bool oswaps::reset_step(uint8_t phase, uint32_t& budget) {
+  // LIQ token stats go with their asset rows, each counted against the budget; a stat
+  //   erased without its asset row is simply not found by the next call
+  auto erase_liq_stat = [&](symbol_code liq_sym_code) {
+    stats lstattable(get_self(), liq_sym_code.raw());
+    auto lst = lstattable.find(liq_sym_code.raw());
+    if (lst != lstattable.end()) {
+      lstattable.erase(lst);
+      --budget;
+    }
+    return budget > 0;
+  };
+  switch (phase) {
+    case reset_tokens: {
+      tokensa assettable(get_self(), get_self().value);
+      auto a = assettable.begin();
+      while (a != assettable.end() && budget > 0 && erase_liq_stat(a->liq_symbol.code())) {
+        a = assettable.erase(a);
+        --budget;
+      }
+      return a == assettable.end();
+    }
+    case reset_legacy: {
+      legacyassetsa legacytable(get_self(), get_self().value);
+      auto l = legacytable.begin();
+      while (l != legacytable.end() && budget > 0
+             && erase_liq_stat(symbol_code(liq_code_raw(l->token_id)))) {
+        l = legacytable.erase(l);
+        --budget;
+      }
+      return l == legacytable.end();
+    }
+    case reset_meta:
+      return erase_rows(assetmetas(get_self(), get_self().value), budget);
+    case reset_chains:
+      return erase_rows(chains(get_self(), get_self().value), budget);
+    case reset_withdrawals:
+      return erase_rows(withdrawals(get_self(), get_self().value), budget);
+    case reset_intents:
+      return erase_rows(intents(get_self(), get_self().value), budget);
+    case reset_pricerings:
+      return erase_rows(pricerings(get_self(), get_self().value), budget);
+    case reset_batchconf: {
+      batchconfs batchconfset(get_self(), get_self().value);
+      if (batchconfset.exists()) {
+        if (budget == 0) {
+          return false;
+        }
+        batchconfset.remove();
+        --budget;
+      }
+      return true;
+    }
+  }
+  return true;
 }
 
-void oswaps::resetacct( const name& account )
+void oswaps::save_cleanup(const cleanup& state) {
+  cleanups cleanupset(get_self(), get_self().value);
+  if (state.reset_phase == reset_idle && state.gc_account == name() && state.last_token_id == 0) {
+    if (cleanupset.exists()) { cleanupset.remove(); }
+  } else {
+    cleanupset.set(state, get_self());
+  }
+}
+
+void oswaps::resetacct( const name& account, uint32_t max_rows )
 {
   require_auth2( get_self().value, "owner"_n.value );
-    accounts tbl(get_self(),account.value);
-    auto itr = tbl.begin();
-    while (itr != tbl.end()) {
-      itr = tbl.erase(itr);
+  check(max_rows > 0, "max_rows must be positive");
+  accounts tbl(get_self(),account.value);
+  lpfees feetable(get_self(), account.value);
+  deposits deptable(get_self(), account.value);
+  uint32_t budget = max_rows;
+  if (!erase_rows(tbl, budget) || !erase_rows(feetable, budget)) {
+    return;
+  }
+  // erased deposits leave their asset's deposit total, so reconcile returns them to the pool
+  tokensa assettable(get_self(), get_self().value);
+  for (auto d = deptable.begin(); d != deptable.end() && budget > 0; --budget) {
+    auto a = assettable.find(d->token_id);
+    if (a != assettable.end()) {
+      assettable.modify(a, same_payer, [&](auto& s) {
+        s.deposits -= d->balance;
+      });
     }
+    d = deptable.erase(d);
+  }
+}
+
+void oswaps::gc(name account, uint32_t max_rows) {
+  check(max_rows > 0, "max_rows must be positive");
+  accounts acnts(get_self(), account.value);
+  check(acnts.begin() != acnts.end(), "no liquidity balances");
+  cleanups cleanupset(get_self(), get_self().value);
+  auto state = cleanupset.get_or_default(cleanup_row);
+  auto itr = acnts.lower_bound(state.gc_account == account ? state.gc_cursor : 0);
+  lpfees feetable(get_self(), account.value);
+  for (uint32_t n = 0; n < max_rows && itr != acnts.end(); ++n) {
+    symbol_code liq_sym_code = itr->balance.symbol.code();
+    stats lstattable(get_self(), liq_sym_code.raw());
+    if (lstattable.find(liq_sym_code.raw()) != lstattable.end()) {
+      ++itr;
+      continue;
+    }
+    // the asset was forgotten
+    auto f = feetable.find(liq_token_id(liq_sym_code.raw()));
+    if (f != feetable.end()) {
+      feetable.erase(f);
+    }
+    itr = acnts.erase(itr);
+  }
+  if (itr == acnts.end()) {
+    state.gc_account = name();
+    state.gc_cursor = 0;
+  } else {
+    state.gc_account = account;
+    state.gc_cursor = itr->primary_key();
+  }
+  save_cleanup(state);
 }
 
 void oswaps::init(name manager, string chain) {
   configs configset(get_self(), get_self().value);
+  cleanups cleanupset(get_self(), get_self().value);
+  auto state = cleanupset.get_or_default(cleanup_row);
+  check(state.reset_phase == reset_idle, "reset in progress");
   bool reconfig = configset.exists();
   auto cfg = configset.get_or_create(get_self(), config_row);
   if(reconfig) {
     require_auth(cfg.manager);
   } else {
     require_auth2(get_self().value, "owner"_n.value);
+    // continue the token ids used before a reset
+    cfg.last_token_id = state.last_token_id;
+    state.last_token_id = 0;
+    save_cleanup(state);
   }
   // TODO parse chain into chain_name, chain_code
   string chain_name = "Telos";
@@ -120,7 +366,7 @@ void oswaps::freeze(name actor, uint64_t token_id, string symbol) {
   auto cfg = configset.get();
   check(actor == cfg.manager, "must be manager");
   require_auth(actor);
-  assetsa assettable(get_self(), get_self().value);
+  tokensa assettable(get_self(), get_self().value);
   auto a = assettable.require_find(token_id, "unrecog token id");
   check(a->symbol == symbol_code(symbol), "mismatched symbol");
   assettable.modify( a, same_payer, [&]( auto& s ) {
@@ -134,7 +380,7 @@ void oswaps::unfreeze(name actor, uint64_t token_id, string symbol) {
   auto cfg = configset.get();
   check(actor == cfg.manager, "must be manager");
   require_auth(actor);
-  assetsa assettable(get_self(), get_self().value);
+  tokensa assettable(get_self(), get_self().value);
   auto a = assettable.require_find(token_id, "unrecog token id");
   check(a->symbol == symbol_code(symbol), "mismatched symbol");
   assettable.modify( a, same_payer, [&]( auto& s ) {
@@ -142,58 +388,212 @@ void oswaps::unfreeze(name actor, uint64_t token_id, string symbol) {
   });
 }
 
+void oswaps::setfee(name actor, uint64_t token_id, string symbol, float fee) {
+  configs configset(get_self(), get_self().value);
+  check(configset.exists(), "not configured.");
+  auto cfg = configset.get();
+  check(actor == cfg.manager, "must be manager");
+  require_auth(actor);
+  tokensa assettable(get_self(), get_self().value);
+  auto a = assettable.require_find(token_id, "unrecog token id");
+  check(a->symbol == symbol_code(symbol), "mismatched symbol");
+  check(fee >= 0.0 && fee <= 0.1, "fee out of range");
+  assettable.modify( a, same_payer, [&]( auto& s ) {
+    s.fee_rate = uint64_t(llround(double(fee) * weight_one));
+  });
+}
+
+void oswaps::setlimit(name actor, uint64_t token_id, asset capacity, asset refill) {
+  configs configset(get_self(), get_self().value);
+  check(configset.exists(), "not configured.");
+  auto cfg = configset.get();
+  check(actor == cfg.manager, "must be manager");
+  require_auth(actor);
+  tokensa assettable(get_self(), get_self().value);
+  auto a = assettable.require_find(token_id, "unrecog token id");
+  check(capacity.symbol == a->balance.symbol && refill.symbol == a->balance.symbol,
+    "mismatched symbol");
+  check(capacity.amount >= 0 && refill.amount >= 0, "limit must not be negative");
+  assettable.modify( a, same_payer, [&]( auto& s ) {
+    s.limit.capacity = capacity.amount;
+    s.limit.refill = refill.amount;
+    s.limit.level = capacity.amount;
+    s.limit.updated = current_time_point().sec_since_epoch();
+  });
+}
+
 oswaps::poolStatus oswaps::querypool(std::vector<uint64_t> token_id_list){
   poolStatus rv;
-  assetsa assettable(get_self(), get_self().value);
+  tokensa assettable(get_self(), get_self().value);
+  if (token_id_list.empty()) {
+    // the first page of the pool, which must be all of it; the result has no room to say
+    //   that it is incomplete
+    poolPage page = querypage(0, page_max_rows);
+    check(page.more == 0, "pool has more than 100 tokens, use querypage");
+    rv.status_entries = std::move(page.status_entries);
+    return rv;
+  }
   for (const uint64_t& token_id : token_id_list) {
     auto a = assettable.require_find(token_id, "unrecog token id in query list");
-    name contract = a->contract_name;
-    accounts accttable(contract, get_self().value);
-    auto ac = accttable.find(a->symbol.raw());
-    stats stattable(contract, a->symbol.raw());
-    auto st = stattable.require_find(a->symbol.raw(), "can't stat symbol");
-    asset balance(0, st->supply.symbol);
-    if(ac != accttable.end()) {
-      balance.amount = ac->balance.amount;
-    }
     statusEntry e;
     e.token_id = token_id;
-    e.balance = balance;
+    e.balance = a->balance;
     e.weight = a->weight;
     rv.status_entries.push_back(e);
   }
   return rv;
 }
 
+oswaps::poolPage oswaps::querypage(uint64_t lower_bound, uint32_t limit) {
+  poolPage rv;
+  rv.more = 0;
+  if (limit == 0 || limit > page_max_rows) {
+    limit = page_max_rows;
+  }
+  tokensa assettable(get_self(), get_self().value);
+  for (auto a = assettable.lower_bound(lower_bound); a != assettable.end(); ++a) {
+    if (rv.status_entries.size() == limit) {
+      rv.more = a->token_id;
+      break;
+    }
+    rv.status_entries.push_back({a->token_id, a->balance, a->weight});
+  }
+  return rv;
+}
+
+oswaps::swapQuotes oswaps::quote(std::vector<swapRequest> requests) {
+  swapQuotes rv;
+  tokensa assettable(get_self(), get_self().value);
+  for (const swapRequest& r : requests) {
+    auto ain = assettable.require_find(r.in_token_id, "unrecog input token id in quote");
+    auto aout = assettable.require_find(r.out_token_id, "unrecog output token id in quote");
+    check(r.amount.symbol == (r.exact_in ? ain->balance.symbol : aout->balance.symbol),
+      "quote amount symbol mismatch");
+    // spot prices in output token units per input token unit, before and after
+    double spot_before = (double(aout->balance.amount)/aout->weight)
+                         / (double(ain->balance.amount)/ain->weight);
+    double decimals = 1.0;
+    for (int i = aout->balance.symbol.precision(); i < ain->balance.symbol.precision(); ++i) {
+      decimals *= 10.0;
+    }
+    for (int i = ain->balance.symbol.precision(); i < aout->balance.symbol.precision(); ++i) {
+      decimals /= 10.0;
+    }
+    quoteEntry e;
+    e.in_amount = asset(0, ain->balance.symbol);
+    e.out_amount = asset(0, aout->balance.symbol);
+    e.spot_price = spot_before * decimals;
+    e.price_impact = 0.0;
+    // a swap the pool would refuse now is reported, without failing the other quotes
+    if (!ain->active || !aout->active) {
+      e.status = "frozen"_n;
+      rv.quote_entries.push_back(e);
+      continue;
+    }
+    swap_result sw = compute_swap(*ain, *aout, r.amount.amount, r.exact_in);
+    if (sw.out_amount > aout->limit.available()) {
+      e.status = "ratelimited"_n;
+      rv.quote_entries.push_back(e);
+      continue;
+    }
+    double spot_after = (double(sw.out_bal_after)/aout->weight)
+                        / (double(sw.in_bal_after)/ain->weight);
+    e.status = "ok"_n;
+    e.in_amount.amount = sw.in_amount;
+    e.out_amount.amount = sw.out_amount;
+    e.spot_price = spot_after * decimals;
+    if (sw.in_amount > 0 && spot_before > 0.0) {
+      e.price_impact = 1.0 - (double(sw.out_amount)/sw.in_amount) / spot_before;
+    }
+    rv.quote_entries.push_back(e);
+  }
+  return rv;
+}
+
+oswaps::accountFees oswaps::queryfees(name account, std::vector<uint64_t> token_id_list) {
+  accountFees rv;
+  tokensa assettable(get_self(), get_self().value);
+  for (const uint64_t& token_id : token_id_list) {
+    auto a = assettable.require_find(token_id, "unrecog token id in query list");
+    feeEntry e;
+    e.token_id = token_id;
+    e.fees = asset(earned_fees(account, *a), a->balance.symbol);
+    rv.fee_entries.push_back(e);
+  }
+  return rv;
+}
+
+oswaps::twapPrice oswaps::querytwap(uint64_t token_id, uint64_t quote_token_id,
+                                    uint32_t start, uint32_t end) {
+  tokensa assettable(get_self(), get_self().value);
+  auto a = assettable.require_find(token_id, "unrecog token id");
+  auto q = assettable.require_find(quote_token_id, "unrecog quote token id");
+  if (end == 0) {
+    end = current_time_point().sec_since_epoch();
+  }
+  check(start < end, "start must be before end");
+  // the log of the quote per token price is the difference of their accumulators
+  auto log_diff = [&](uint32_t time) {
+    return price_cum_at(*q, time) - price_cum_at(*a, time);
+  };
+  __int128 log_sum = __int128(log_diff(end) - log_diff(start));
+  double price = exp2(double(log_sum) / double(oswaps_math::one) / (end - start));
+  for (int i = q->balance.symbol.precision(); i < a->balance.symbol.precision(); ++i) {
+    price *= 10.0;
+  }
+  for (int i = a->balance.symbol.precision(); i < q->balance.symbol.precision(); ++i) {
+    price /= 10.0;
+  }
+  return twapPrice{start, end, price};
+}
+
 void oswaps::createasseta(name actor, string chain, name contract, symbol_code symbol, string meta) {
   require_auth(actor);
   check(contract != get_self(), "asset contract cannot be oswaps");
-  assetsa assettable(get_self(), get_self().value);
+  tokensa assettable(get_self(), get_self().value);
   // TODO parse chain into chain_name, chain_code
   string chain_name = "Telos";
   checksum256 chain_code = telos_chain_id;
   check(chain == chain_name, "currently only Telos chain supported");
+  auto tokenindex = assettable.get_index<"bytoken"_n>();
+  check(tokenindex.find(token_key(contract, symbol)) == tokenindex.end(),
+        "asset already registered");
   configs configset(get_self(), get_self().value);
   auto cfg = configset.get();
   cfg.last_token_id += 1;
   configset.set(cfg, get_self());
+  stats astattable(contract, symbol.raw());
+  auto ast = astattable.require_find(symbol.raw(), "can't stat symbol");
+  // LIQ token with correct precision
+  uint64_t liq_raw = liq_code_raw(cfg.last_token_id);
+  check(liq_raw != 0, "token id too large for LIQ symbol");
+  auto liq_sym_code = symbol_code(liq_raw);
+  auto liq_sym = eosio::symbol(liq_sym_code, ast->supply.symbol.precision());
+  uint16_t chain_ord = chain_ordinal(chain_code);
   assettable.emplace(actor, [&]( auto& s ) {
     s.token_id = cfg.last_token_id;
-    s.chain_code = chain_code;
+    s.chain = chain_ord;
     s.contract_name = contract;
     s.symbol = symbol;
     s.active = false;
-    s.metadata = meta;
-    s.weight = 0.0;
+    s.weight = 0;
+    s.balance = asset(0, ast->supply.symbol);
+    s.liq_symbol = liq_sym;
+    s.fee_rate = 0;
+    s.fee_growth = 0;
+    s.fees = asset(0, ast->supply.symbol);
+    s.limit = {};
+    s.deposits = asset(0, ast->supply.symbol);
+    s.price_cum = 0;
+    s.price_updated = 0;
   });
-  // create LIQ token with correct precision
-  stats astattable(contract, symbol.raw());
-  auto ast = astattable.require_find(symbol.raw(), "can't stat symbol");
-  auto liq_sym_code = symbol_code(sym_from_id(cfg.last_token_id, "LIQ"));
-  auto liq_sym = eosio::symbol(liq_sym_code, ast->supply.symbol.precision());
-  printf("liq sym code id %llu %s %s", cfg.last_token_id,
-            liq_sym_code.to_string().c_str(),
-            name(liq_sym_code.raw()).to_string().c_str());
+  if (!meta.empty()) {
+    assetmetas metatable(get_self(), get_self().value);
+    metatable.emplace(actor, [&]( auto& s ) {
+      s.token_id = cfg.last_token_id;
+      s.metadata = meta;
+    });
+  }
   stats lstattable(get_self(), liq_sym_code.raw());
   auto existing = lstattable.find(liq_sym_code.raw());
   //check( existing == lstattable.end(), "liquidity token already exists");
@@ -218,55 +618,172 @@ void oswaps::forgetasset(name actor, uint64_t token_id, string memo) {
   auto cfg = configset.get();
   check(actor == cfg.manager, "must be manager");
   require_auth(actor);
-  assetsa assettable(get_self(), get_self().value);
+  tokensa assettable(get_self(), get_self().value);
   auto a = assettable.require_find(token_id, "unrecog token id");
+  check(a->deposits.amount == 0, "asset has deposits");
+  auto liq_sym_code = a->liq_symbol.code();
   assettable.erase(a);
+  assetmetas metatable(get_self(), get_self().value);
+  auto m = metatable.find(token_id);
+  if (m != metatable.end()) {
+    metatable.erase(m);
+  }
+  pricerings ringtable(get_self(), get_self().value);
+  auto r = ringtable.find(token_id);
+  if (r != ringtable.end()) {
+    ringtable.erase(r);
+  }
   // should we check for zero balance before destroying LIQ token?
-  auto liq_sym_code = symbol_code(sym_from_id(token_id, "LIQ"));
   stats lstattable(get_self(), liq_sym_code.raw());
   auto lst = lstattable.begin();
   while ( lst != lstattable.end()) {
     lst = lstattable.erase(lst);
   }
-  // accounts table has stranded ram & data which could create weirdness
+  // LIQ balances are left to `gc`
 }  
 
-void oswaps::withdraw(name account, uint64_t token_id, string amount, float weight) {
+void oswaps::migrate(name actor, uint32_t max_rows) {
   configs configset(get_self(), get_self().value);
   check(configset.exists(), "not configured.");
   auto cfg = configset.get();
-  require_auth(cfg.manager);
-  assetsa assettable(get_self(), get_self().value);
+  check(actor == cfg.manager, "must be manager");
+  require_auth(actor);
+  check(max_rows > 0, "max_rows must be positive");
+  legacyassetsa legacytable(get_self(), get_self().value);
+  check(legacytable.begin() != legacytable.end(), "nothing to migrate");
+  tokensa assettable(get_self(), get_self().value);
+  assetmetas metatable(get_self(), get_self().value);
+  auto l = legacytable.begin();
+  for (uint32_t n = 0; n < max_rows && l != legacytable.end(); ++n) {
+    uint16_t chain_ord = chain_ordinal(l->chain_code);
+    stats stattable(l->contract_name, l->symbol.raw());
+    auto st = stattable.require_find(l->symbol.raw(), "can't stat symbol");
+    // the original contract's pool was its whole holding of the token
+    asset balance(0, st->supply.symbol);
+    accounts accttable(l->contract_name, get_self().value);
+    auto ac = accttable.find(l->symbol.raw());
+    if (ac != accttable.end()) {
+      balance.amount = ac->balance.amount;
+    }
+    uint64_t liq_raw = liq_code_raw(l->token_id);
+    stats lstattable(get_self(), liq_raw);
+    auto lst = lstattable.find(liq_raw);
+    eosio::symbol liq_sym = lst != lstattable.end() ? lst->supply.symbol
+                            : eosio::symbol(symbol_code(liq_raw), balance.symbol.precision());
+    assettable.emplace(get_self(), [&]( auto& s ) {
+      s.token_id = l->token_id;
+      s.chain = chain_ord;
+      s.contract_name = l->contract_name;
+      s.symbol = l->symbol;
+      s.active = l->active;
+      s.weight = weight_from(l->weight);
+      s.balance = balance;
+      s.liq_symbol = liq_sym;
+      s.fee_rate = 0;
+      s.fee_growth = 0;
+      s.fees = asset(0, balance.symbol);
+      s.limit = {};
+      s.deposits = asset(0, balance.symbol);
+      s.price_cum = 0;
+      s.price_updated = 0;
+    });
+    if (!l->metadata.empty()) {
+      metatable.emplace(get_self(), [&]( auto& s ) {
+        s.token_id = l->token_id;
+        s.metadata = l->metadata;
+      });
+    }
+    l = legacytable.erase(l);
+  }
+}
+
+// ordinal of a chain in the chains table, registering it if new
+uint16_t oswaps::chain_ordinal(const checksum256& chain_id) {
+  chains chaintable(get_self(), get_self().value);
+  for (const chain& c : chaintable) {
+    if (c.chain_id == chain_id) {
+      return uint16_t(c.ordinal);
+    }
+  }
+  uint64_t ordinal = chaintable.available_primary_key();
+  check(ordinal <= UINT16_MAX, "too many chains");
+  chaintable.emplace(get_self(), [&]( auto& s ) {
+    s.ordinal = ordinal;
+    s.chain_id = chain_id;
+  });
+  return uint16_t(ordinal);
+}
+
+void oswaps::reconcile(name actor, uint64_t token_id) {
+  configs configset(get_self(), get_self().value);
+  check(configset.exists(), "not configured.");
+  auto cfg = configset.get();
+  check(actor == cfg.manager, "must be manager");
+  require_auth(actor);
+  tokensa assettable(get_self(), get_self().value);
   auto a = assettable.require_find(token_id, "unrecog token id");
-  // TODO verify chain, family, and contract
   stats stattable(a->contract_name, a->symbol.raw());
   auto st = stattable.require_find(a->symbol.raw(), "can't stat symbol");
-  uint64_t amount64 = amount_from(st->supply.symbol, amount);
-  asset qty = asset(amount64, st->supply.symbol);
   accounts accttable(a->contract_name, get_self().value);
   auto ac = accttable.find(a->symbol.raw());
-  uint64_t bal_before = 0;
+  asset balance(0, st->supply.symbol);
   if(ac != accttable.end()) {
-    bal_before = ac->balance.amount;
+    balance.amount = ac->balance.amount;
+  }
+  // unclaimed fees, deposits and escrowed intents are held alongside the pool but are
+  //   not part of it
+  balance -= a->fees;
+  balance -= a->deposits;
+  intents intenttable(get_self(), get_self().value);
+  for (const intent& i : intenttable) {
+    if (i.in_token_id == token_id && i.in_amount.symbol == balance.symbol) {
+      balance -= i.in_amount;
+    }
   }
+  assettable.modify(a, same_payer, [&](auto& s) {
+    observe(s);
+    s.balance = balance;
+  });
+}
+
+void oswaps::withdraw(name account, uint64_t token_id, string amount, float weight) {
+  tokensa assettable(get_self(), get_self().value);
+  auto a = assettable.require_find(token_id, "unrecog token id");
+  withdraw2(account, token_id, asset(amount_from(a->balance.symbol, amount), a->balance.symbol),
+            weight);
+}
+
+void oswaps::withdraw2(name account, uint64_t token_id, asset amount, float weight) {
+  configs configset(get_self(), get_self().value);
+  check(configset.exists(), "not configured.");
+  auto cfg = configset.get();
+  require_auth(cfg.manager);
+  tokensa assettable(get_self(), get_self().value);
+  auto a = assettable.require_find(token_id, "unrecog token id");
+  // TODO verify chain, family, and contract
+  check(amount.symbol == a->balance.symbol, "mismatched symbol");
+  check(amount.amount >= 0, "withdraw amount must be positive");
+  uint64_t amount64 = amount.amount;
+  asset qty = amount;
+  uint64_t bal_before = a->balance.amount;
   check(bal_before > amount64, "withdraw: insufficient balance");
-  float new_weight = weight;
-  if(weight == 0.0) {
-    new_weight = a->weight * (1.0 - float(amount64)/bal_before);
+  uint64_t new_weight = weight_from(weight);
+  if(new_weight == 0) {
+    new_weight = scale_weight(a->weight, bal_before - amount64, bal_before);
   }
+  log_liq(account, *a, bal_before - amount64, new_weight);
   assettable.modify(a, same_payer, [&](auto& s) {
+    observe(s);
     s.weight = new_weight;
     s.active &= (weight == 0.0);
+    s.balance -= qty;
+    s.limit.draw(qty.amount, s.symbol);
   });
   // burn LIQ tokens 
   cfg.withdraw_flag = true;
   configset.set(cfg, get_self());
   // send the LIQ tokens home to retire
-  auto liq_sym_code = symbol_code(sym_from_id(token_id, "LIQ"));
-  stats lstatstable( get_self(), liq_sym_code.raw() );
-  const auto& lst = lstatstable.get( liq_sym_code.raw() );
-  asset lqty = qty;
-  lqty.symbol = symbol(liq_sym_code, qty.symbol.precision());
+  asset lqty = asset(qty.amount, a->liq_symbol);
   action (
     permission_level{get_self(), "active"_n},
     get_self(),
@@ -282,23 +799,429 @@ void oswaps::withdraw(name account, uint64_t token_id, string amount, float weig
   ).send(); 
 }
 
+void oswaps::claimfees(name account, uint64_t token_id) {
+  require_auth(account);
+  tokensa assettable(get_self(), get_self().value);
+  auto a = assettable.require_find(token_id, "unrecog token id");
+  settle_fees(account, *a, account);
+  lpfees feetable(get_self(), account.value);
+  auto f = feetable.find(token_id);
+  check(f != feetable.end() && f->owed > 0, "no fees to claim");
+  asset qty = asset(f->owed, a->balance.symbol);
+  feetable.modify(f, same_payer, [&](auto& s) {
+    s.owed = 0;
+  });
+  assettable.modify(a, same_payer, [&](auto& s) {
+    s.fees -= qty;
+  });
+  action (
+    permission_level{get_self(), "active"_n},
+    a->contract_name,
+    "transfer"_n,
+    std::make_tuple(get_self(), account, qty, std::string("oswaps fees"))
+  ).send();
+}
+
+void oswaps::swapint(name account, uint64_t in_token_id, uint64_t out_token_id, asset in_amount,
+                     int64_t min_out) {
+  require_auth(account);
+  tokensa assettable(get_self(), get_self().value);
+  auto ain = assettable.require_find(in_token_id, "unrecog input token id");
+  auto aout = assettable.require_find(out_token_id, "unrecog output token id");
+  check(in_amount.symbol == ain->balance.symbol, "mismatched symbol");
+  check(in_amount.amount > 0, "swap amount must be positive");
+  swap_result sw = compute_swap(*ain, *aout, in_amount.amount, true);
+  check(sw.out_amount >= min_out, "swap output is less than min_out");
+  log_swap(account, account, *ain, *aout, sw);
+  sub_deposit(account, *ain, sw.in_amount);
+  add_deposit(account, *aout, sw.out_amount, account);
+  assettable.modify(ain, same_payer, [&](auto& s) {
+    observe(s);
+    s.balance.amount = sw.in_bal_after;
+    s.deposits.amount -= sw.in_amount;
+    accrue_fee(s, sw.fee);
+  });
+  assettable.modify(aout, same_payer, [&](auto& s) {
+    observe(s);
+    s.balance.amount = sw.out_bal_after;
+    s.deposits.amount += sw.out_amount;
+    s.limit.draw(sw.out_amount, s.symbol);
+  });
+}
+
+void oswaps::depwithdraw(name account, uint64_t token_id, asset amount) {
+  require_auth(account);
+  tokensa assettable(get_self(), get_self().value);
+  auto a = assettable.require_find(token_id, "unrecog token id");
+  check(amount.symbol == a->balance.symbol, "mismatched symbol");
+  check(amount.amount > 0, "withdraw amount must be positive");
+  sub_deposit(account, *a, amount.amount);
+  assettable.modify(a, same_payer, [&](auto& s) {
+    s.deposits -= amount;
+  });
+  action (
+    permission_level{get_self(), "active"_n},
+    a->contract_name,
+    "transfer"_n,
+    std::make_tuple(get_self(), account, amount, std::string("oswaps deposit withdrawal"))
+  ).send();
+}
+
+void oswaps::batch(name account, std::vector<batchOp> ops) {
+  require_auth(account);
+  check(!ops.empty(), "empty batch");
+  tokensa assettable(get_self(), get_self().value);
+  // asset rows are updated in memory and written once, as in a route; net[i] is the
+  //   amount of rows[i]'s token owed to the account, or by it if negative
+  std::vector<assettypea> rows;
+  std::vector<int64_t> net;
+  auto row = [&](uint64_t token_id) -> size_t {
+    for (size_t i = 0; i < rows.size(); ++i) {
+      if (rows[i].token_id == token_id) { return i; }
+    }
+    rows.push_back(*assettable.require_find(token_id, "unrecog token id in batch"));
+    observe(rows.back());
+    net.push_back(0);
+    return rows.size() - 1;
+  };
+  bool manager_checked = false;
+  for (const batchOp& o : ops) {
+    size_t r = row(o.token_id);
+    check(o.amount.symbol == rows[r].balance.symbol, "mismatched symbol");
+    if (o.op == "swap"_n) {
+      size_t out = row(o.out_token_id);
+      check(o.amount.amount > 0, "swap amount must be positive");
+      swap_result sw = compute_swap(rows[r], rows[out], o.amount.amount, true);
+      check(sw.out_amount >= o.min_out, "swap output is less than min_out");
+      log_swap(account, account, rows[r], rows[out], sw);
+      rows[r].balance.amount = sw.in_bal_after;
+      accrue_fee(rows[r], sw.fee);
+      rows[out].balance.amount = sw.out_bal_after;
+      rows[out].limit.draw(sw.out_amount, rows[out].symbol);
+      net[r] -= sw.in_amount;
+      net[out] += sw.out_amount;
+    } else if (o.op == "addliq"_n) {
+      assettypea& a = rows[r];
+      int64_t amount = o.amount.amount;
+      // as for `addliqprep2`, whose transfer cannot be empty; a weight change alone needs
+      //   the manager's `withdraw2`
+      check(amount > 0, "liquidity amount must be positive");
+      check(a.active, "token is frozen");
+      uint64_t new_weight = weight_from(o.weight);
+      if (new_weight == 0) {
+        check(a.balance.amount > 0, "zero weight requires existing balance");
+        new_weight = scale_weight(a.weight, a.balance.amount + amount, a.balance.amount);
+      }
+      log_liq(account, a, a.balance.amount + amount, new_weight);
+      a.weight = new_weight;
+      a.active &= (o.weight == 0.0);
+      a.balance.amount += amount;
+      a.limit.draw(amount, a.symbol);
+      net[r] -= amount;
+      // LIQ balances change as they go, as in a crank, so fees accrue exactly
+      asset lqty = asset(amount, a.liq_symbol);
+      settle_fees(account, a, account);
+      add_balance(account, lqty, account);
+      stats lstatstable(get_self(), lqty.symbol.code().raw());
+      lstatstable.modify(lstatstable.get(lqty.symbol.code().raw()), same_payer, [&](auto& s) {
+        s.supply += lqty;
+      });
+    } else if (o.op == "withdraw"_n) {
+      if (!manager_checked) {
+        configs configset(get_self(), get_self().value);
+        check(configset.exists(), "not configured.");
+        require_auth(configset.get().manager);
+        manager_checked = true;
+      }
+      assettypea& a = rows[r];
+      int64_t amount = o.amount.amount;
+      check(amount >= 0, "withdraw amount must be positive");
+      check(a.balance.amount > amount, "withdraw: insufficient balance");
+      uint64_t new_weight = weight_from(o.weight);
+      if (new_weight == 0) {
+        new_weight = scale_weight(a.weight, a.balance.amount - amount, a.balance.amount);
+      }
+      log_liq(account, a, a.balance.amount - amount, new_weight);
+      a.weight = new_weight;
+      a.active &= (o.weight == 0.0);
+      a.balance.amount -= amount;
+      a.limit.draw(amount, a.symbol);
+      net[r] += amount;
+      if (amount > 0) {
+        asset lqty = asset(amount, a.liq_symbol);
+        settle_fees(account, a, account);
+        sub_balance(account, lqty);
+        stats lstatstable(get_self(), lqty.symbol.code().raw());
+        lstatstable.modify(lstatstable.get(lqty.symbol.code().raw()), same_payer, [&](auto& s) {
+          s.supply -= lqty;
+        });
+      }
+    } else {
+      check(false, "unrecog batch op");
+    }
+  }
+  // settle the net amounts: debits from deposits, credits by transfer
+  std::vector<payment> payments;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    if (net[i] < 0) {
+      sub_deposit(account, rows[i], -net[i]);
+      rows[i].deposits.amount += net[i];
+    } else {
+      add_payment(payments, rows[i].contract_name, account,
+                  asset(net[i], rows[i].balance.symbol));
+    }
+    assettable.modify(assettable.find(rows[i].token_id), same_payer, [&](auto& s) {
+      s = rows[i];
+    });
+  }
+  for (const payment& p : payments) {
+    action (
+      permission_level{get_self(), "active"_n},
+      p.contract,
+      "transfer"_n,
+      std::make_tuple(get_self(), p.to, p.quantity, std::string("oswaps batch"))
+    ).send();
+  }
+}
+
+void oswaps::withdrawq(name account, uint64_t token_id, asset amount) {
+  configs configset(get_self(), get_self().value);
+  check(configset.exists(), "not configured.");
+  auto cfg = configset.get();
+  require_auth(cfg.manager);
+  tokensa assettable(get_self(), get_self().value);
+  auto a = assettable.require_find(token_id, "unrecog token id");
+  check(amount.symbol == a->balance.symbol, "mismatched symbol");
+  check(amount.amount > 0, "withdraw amount must be positive");
+  // the crank settles the account's fees into its checkpoint, which is created here at
+  //   the manager's expense, as the queue entry is, rather than later at the contract's
+  lpfees feetable(get_self(), account.value);
+  if (feetable.find(token_id) == feetable.end()) {
+    int64_t owed = earned_fees(account, *a);
+    feetable.emplace(cfg.manager, [&](auto& s) {
+      s.token_id = token_id;
+      s.fee_growth = a->fee_growth;
+      s.owed = owed;
+    });
+  }
+  withdrawals queue(get_self(), get_self().value);
+  queue.emplace(cfg.manager, [&](auto& s) {
+    s.id = queue.available_primary_key();
+    s.account = account;
+    s.token_id = token_id;
+    s.amount = amount;
+  });
+}
+
+void oswaps::crank(uint32_t max_items) {
+  check(max_items > 0, "max_items must be positive");
+  withdrawals queue(get_self(), get_self().value);
+  check(queue.begin() != queue.end(), "no queued withdrawals");
+  tokensa assettable(get_self(), get_self().value);
+  // asset rows are updated in memory and written once, as in a route
+  std::vector<assettypea> rows;
+  struct payout {
+    name account;
+    size_t row;
+    int64_t amount;
+  };
+  std::vector<payout> payouts;
+  auto w = queue.begin();
+  for (uint32_t n = 0; n < max_items && w != queue.end(); ++n) {
+    auto found = assettable.find(w->token_id);
+    if (found == assettable.end()) {
+      w = queue.erase(w);
+      continue;
+    }
+    size_t r = 0;
+    while (r < rows.size() && rows[r].token_id != w->token_id) {
+      ++r;
+    }
+    if (r == rows.size()) {
+      rows.push_back(*found);
+      observe(rows.back());
+    }
+    assettypea& a = rows[r];
+    int64_t amount = w->amount.amount;
+    if (amount > a.limit.available()) {
+      break;
+    }
+    asset lqty = asset(amount, a.liq_symbol);
+    accounts acnts(get_self(), w->account.value);
+    auto ac = acnts.find(lqty.symbol.code().raw());
+    lpfees feetable(get_self(), w->account.value);
+    bool checkpointed = feetable.find(a.token_id) != feetable.end();
+    // a withdrawal which would round the token's weight to zero is never met either, nor
+    //   one whose fee checkpoint (made by `withdrawq`) has since been erased
+    if (w->amount.symbol != a.balance.symbol || a.balance.amount <= amount
+        || ac == acnts.end() || ac->balance.amount < amount
+        || (!checkpointed && a.fee_growth != 0)
+        || oswaps_math::uint128(a.weight) * uint64_t(a.balance.amount - amount)
+             < uint64_t(a.balance.amount)) {
+      w = queue.erase(w);
+      continue;
+    }
+    // burn the LIQ tokens
+    settle_fees(w->account, a, w->account); // updates the checkpoint; never creates one
+    sub_balance(w->account, lqty);
+    stats lstatstable(get_self(), lqty.symbol.code().raw());
+    lstatstable.modify(lstatstable.get(lqty.symbol.code().raw()), same_payer, [&](auto& s) {
+      s.supply -= lqty;
+    });
+    uint64_t new_weight = scale_weight(a.weight, a.balance.amount - amount, a.balance.amount);
+    log_liq(w->account, a, a.balance.amount - amount, new_weight);
+    a.weight = new_weight;
+    a.balance.amount -= amount;
+    a.limit.draw(amount, a.symbol);
+    size_t p = 0;
+    while (p < payouts.size() && !(payouts[p].account == w->account && payouts[p].row == r)) {
+      ++p;
+    }
+    if (p == payouts.size()) {
+      payouts.push_back({w->account, r, 0});
+    }
+    payouts[p].amount += amount;
+    w = queue.erase(w);
+  }
+  for (const assettypea& a : rows) {
+    assettable.modify(assettable.find(a.token_id), same_payer, [&](auto& s) {
+      s = a;
+    });
+  }
+  for (const payout& p : payouts) {
+    action (
+      permission_level{get_self(), "active"_n},
+      rows[p.row].contract_name,
+      "transfer"_n,
+      std::make_tuple(get_self(), p.account, asset(p.amount, rows[p.row].balance.symbol),
+        std::string("oswaps withdrawal"))
+    ).send();
+  }
+}
+
+void oswaps::setbatch(name actor, uint32_t window) {
+  configs configset(get_self(), get_self().value);
+  check(configset.exists(), "not configured.");
+  auto cfg = configset.get();
+  check(actor == cfg.manager, "must be manager");
+  require_auth(actor);
+  batchconfs batchconfset(get_self(), get_self().value);
+  auto bc = batchconfset.get_or_default(batchconf_row);
+  bc.window = window;
+  batchconfset.set(bc, get_self());
+}
+
+void oswaps::settle(uint32_t max_items) {
+  check(max_items > 0, "max_items must be positive");
+  batchconfs batchconfset(get_self(), get_self().value);
+  uint32_t now = current_time_point().sec_since_epoch();
+  // once batching is disabled, every remaining intent is due
+  bool disabled = batchconfset.get_or_default(batchconf_row).window == 0;
+  intents intenttable(get_self(), get_self().value);
+  std::vector<intent> due;
+  for (auto i = intenttable.begin();
+       i != intenttable.end() && due.size() < max_items && (disabled || i->closes <= now); ) {
+    due.push_back(*i);
+    i = intenttable.erase(i);
+  }
+  check(!due.empty(), "no intents to settle");
+  tokensa assettable(get_self(), get_self().value);
+  // asset rows are updated in memory and written once, as in a route
+  std::vector<assettypea> rows;
+  auto row = [&](uint64_t token_id) -> size_t {
+    for (size_t i = 0; i < rows.size(); ++i) {
+      if (rows[i].token_id == token_id) { return i; }
+    }
+    auto a = assettable.find(token_id);
+    if (a == assettable.end()) { return SIZE_MAX; }
+    rows.push_back(*a);
+    observe(rows.back());
+    return rows.size() - 1;
+  };
+  std::vector<payment> payments;
+  while (!due.empty()) {
+    uint64_t x_id = due.front().in_token_id;
+    uint64_t y_id = due.front().out_token_id;
+    std::vector<intent> batch;
+    std::vector<intent> rest;
+    for (const intent& i : due) {
+      bool same_pair = (i.in_token_id == x_id && i.out_token_id == y_id)
+                       || (i.in_token_id == y_id && i.out_token_id == x_id);
+      (same_pair ? batch : rest).push_back(i);
+    }
+    due.swap(rest);
+    size_t x = row(x_id);
+    size_t y = row(y_id);
+    if (x == SIZE_MAX || y == SIZE_MAX) {
+      for (const intent& i : batch) {
+        add_payment(payments, i.in_contract, i.sender, i.in_amount);
+      }
+      continue;
+    }
+    clear_pair(rows[x], rows[y], batch, payments);
+  }
+  for (const assettypea& a : rows) {
+    assettable.modify(assettable.find(a.token_id), same_payer, [&](auto& s) {
+      s = a;
+    });
+  }
+  for (const payment& p : payments) {
+    action (
+      permission_level{get_self(), "active"_n},
+      p.contract,
+      "transfer"_n,
+      std::make_tuple(get_self(), p.to, p.quantity, std::string("oswaps batch settlement"))
+    ).send();
+  }
+}
+
 void oswaps::addliqprep(name account, uint64_t token_id,
                             string amount, float weight) {
                           
-  save_transaction("addliqprep"_n, token_id);
+  check_prep_transaction("addliqprep"_n, token_id);
+
+}
 
+void oswaps::addliqprep2(name account, uint64_t token_id,
+                             asset amount, float weight) {
+  check_prep_transaction("addliqprep2"_n, token_id);
 }
 
 void oswaps::exprepfrom(
            name sender, name recipient, uint64_t in_token_id, uint64_t out_token_id,
            string in_amount, string memo) {
-  save_transaction("exprepfrom"_n, in_token_id);
+  check_prep_transaction("exprepfrom"_n, in_token_id);
+}
+
+void oswaps::exprepfrom2(
+           name sender, name recipient, uint64_t in_token_id, uint64_t out_token_id,
+           asset in_amount, string memo, binary_extension<asset> min_out,
+           binary_extension<time_point_sec> expires) {
+  check_deadline(expires);
+  check_prep_transaction("exprepfrom2"_n, in_token_id);
 }
 
 void oswaps::exprepto(
            name sender, name recipient, uint64_t in_token_id, uint64_t out_token_id,
            string out_amount, string memo) {
-  save_transaction("exprepto"_n, in_token_id);
+  check_prep_transaction("exprepto"_n, in_token_id);
+}
+
+void oswaps::exprepto2(
+           name sender, name recipient, uint64_t in_token_id, uint64_t out_token_id,
+           asset out_amount, string memo, binary_extension<asset> max_in,
+           binary_extension<time_point_sec> expires) {
+  check_deadline(expires);
+  check_prep_transaction("exprepto2"_n, in_token_id);
+}
+
+void oswaps::exroute(
+           name sender, name recipient, std::vector<uint64_t> path,
+           asset in_amount, asset min_out, string memo,
+           binary_extension<time_point_sec> expires) {
+  check_deadline(expires);
+  check(path.size() >= 2, "route must have at least two tokens");
+  check_prep_transaction("exroute"_n, path.front());
 }
 
 void oswaps::transfer( const name& from, const name& to, const asset& quantity,
@@ -326,6 +1249,14 @@ void oswaps::transfer( const name& from, const name& to, const asset& quantity,
 
     auto payer = has_auth( to ) ? to : from;
 
+    // settle LP fees at the balances before the transfer
+    tokensa assettable(get_self(), get_self().value);
+    auto a = assettable.find(liq_token_id(sym.raw()));
+    if (a != assettable.end()) {
+      if (from != get_self()) { settle_fees( from, *a, payer ); }
+      if (to != get_self()) { settle_fees( to, *a, payer ); }
+    }
+
     sub_balance( from, quantity );
     add_balance( to, quantity, payer );
     
@@ -346,69 +1277,84 @@ void oswaps::transfer( const name& from, const name& to, const asset& quantity,
 
    
 void oswaps::ontransfer(name from, name to, eosio::asset quantity, string memo) {
-    // check if there is a stored transaction
+    // a transfer between other accounts may reach us through a relay's require_recipient;
+    //   only tokens actually received may pay for anything
+    if (from == get_self() || to != get_self()) {
+      return;
+    }
+    // check whether this transfer was preceded by a prep action
     // if not, this is an unrestricted transfer into oswaps
     // [should we also require a confirming memo field?]
-    txx txset(get_self(), get_self().value);
-    if (!txset.exists()) { 
+    if (!memo.empty() && memo[0] == '#') {
+      if (memo.size() > 1 && memo[1] == 'D') {
+        memo_deposit(from, quantity, memo);
+      } else {
+        memo_swap(from, quantity, memo);
+      }
       return;
     }
-
-    if (from == get_self()) {
-      txset.remove();
+    auto size = transaction_size();
+    char *   buffer = (char *)(512 < size ? malloc(size) : alloca(size));
+    tx_view trx = read_trx(buffer, size);
+    if (trx.action_count() < 2) {
+      return;
+    }
+    const tx_action& prep_action = trx.next_to_last(); // should be the prep action
+    // other oswaps actions (claimfees, swapint, ...) may precede a plain transfer
+    name prep_type = name(prep_action.name);
+    if (name(prep_action.account) != get_self() || !is_prep_action(prep_type)) {
       return;
     }
 
-    check(to == get_self(), "This transfer is not for oswaps"); // dispatch error?
     check(quantity.amount >= 0, "transfer quantity must be positive");
     name tkcontract = get_first_receiver();
 
-    // analyze the stored transaction
-    auto tx = txset.get();
-    size_t size = tx.txdata.length();
-    //printf("retrieved serialized tx, size %d ", size);
-    transaction trx = unpack<transaction>(tx.txdata.data(), size);
-    int action_count = trx.actions.size();
-    auto prep_action = trx.actions[action_count-2];
-    check (action_count >= 2, "malformed oswaps trx, <2 actions");
-    prep_action = trx.actions[action_count-2]; // should be the prep action
-    check(prep_action.account == get_self(), "malformed oswaps tx, prep should be next to final");
-    name prep_type = prep_action.name;
-    assetsa assettable(get_self(), get_self().value);
+    // the prep action only covers the final transfer of the transaction
+    const tx_action& final_action = trx.last();
+    check(name(final_action.account) == tkcontract && name(final_action.name) == "transfer"_n,
+      "malformed oswaps tx, prep should be next to final");
+    transfer_params tp = unpack<transfer_params>(final_action.data, final_action.size);
+    check(tp.from == from && tp.to == to && tp.quantity == quantity,
+      "transfer does not match final action of oswaps tx");
+    tokensa assettable(get_self(), get_self().value);
     
-    if (prep_type == "addliqprep"_n) {
-      addliqprep_params ap = unpack<addliqprep_params>(prep_action.data.data(), prep_action.data.size());
+    if (prep_type == "addliqprep"_n || prep_type == "addliqprep2"_n) {
+      addliqprep2_params ap;
+      if (prep_type == "addliqprep2"_n) {
+        ap = unpack<addliqprep2_params>(prep_action.data, prep_action.size);
+      } else {
+        addliqprep_params sp = unpack<addliqprep_params>(prep_action.data, prep_action.size);
+        ap = {sp.account, sp.token_id, asset(amount_from(quantity.symbol, sp.amount),
+              quantity.symbol), sp.weight};
+      }
 
       auto a = assettable.require_find(ap.token_id, "unrecog token id");
       // TODO verify chain & family
       check(a->contract_name == tkcontract, "transfer token contract mismatched to prep");
-      check(a->symbol == quantity.symbol.code(), "transfer symbol mismatched to prep");
-      stats stattable(a->contract_name, a->symbol.raw());
-      auto st = stattable.require_find(a->symbol.raw(), "can't stat symbol");
-      check(st->supply.symbol==quantity.symbol, "transfer symbol/prec mismatched to prep");
-      uint64_t amount64 = amount_from(st->supply.symbol, ap.amount);
-      check(amount64 == quantity.amount, "transfer qty mismatched to prep");   
+      check(a->balance.symbol==quantity.symbol, "transfer symbol/prec mismatched to prep");
+      check(ap.amount.symbol == quantity.symbol && ap.amount.amount == quantity.amount,
+        "transfer qty mismatched to prep");
+      uint64_t amount64 = quantity.amount;
       check(a->active || amount64 == 0, "token is frozen");   
-      accounts accttable(a->contract_name, get_self().value);
-      auto ac = accttable.require_find(a->symbol.raw(), "no pool balance after transfer in");
-      // must back out transfer which just occurred
-      uint64_t bal_before = ac->balance.amount - quantity.amount;
-      float new_weight = ap.weight;
-      if(new_weight == 0.0) {
+      uint64_t bal_before = a->balance.amount;
+      uint64_t new_weight = weight_from(ap.weight);
+      if(new_weight == 0) {
         check(bal_before > 0, "zero weight requires existing balance");
-        new_weight = a->weight * (1.0 + float(amount64)/bal_before);
+        new_weight = scale_weight(a->weight, bal_before + amount64, bal_before);
       }
+      log_liq(from, *a, bal_before + amount64, new_weight);
       assettable.modify(a, same_payer, [&](auto& s) {
+        observe(s);
         s.weight = new_weight;
         s.active &= (ap.weight == 0.0);
+        s.balance += quantity;
+        s.limit.draw(quantity.amount, s.symbol);
       });
       if (quantity.amount > 0) {
         // issue LIQ tokens to self & transfer to `from` account
-        auto liq_sym_code = symbol_code(sym_from_id(ap.token_id, "LIQ"));
-        stats lstatstable( get_self(), liq_sym_code.raw() );
-        const auto& lst = lstatstable.get( liq_sym_code.raw() );
-        asset lqty = quantity;
-        lqty.symbol = symbol(liq_sym_code, quantity.symbol.precision());
+        asset lqty = asset(quantity.amount, a->liq_symbol);
+        stats lstatstable( get_self(), lqty.symbol.code().raw() );
+        const auto& lst = lstatstable.get( lqty.symbol.code().raw() );
         add_balance( get_self(), lqty, get_self() );
         lstatstable.modify( lst, same_payer, [&]( auto& s ) {
           s.supply += lqty;
@@ -422,7 +1368,9 @@ void oswaps::ontransfer(name from, name to, eosio::asset quantity, string memo)
         ).send();
       }
       
-    } else if (prep_type == "exprepfrom"_n || prep_type == "exprepto"_n ) {
+    } else if (prep_type == "exprepfrom"_n || prep_type == "exprepto"_n
+               || prep_type == "exprepfrom2"_n || prep_type == "exprepto2"_n
+               || prep_type == "exroute"_n ) {
       // exchange transaction
       name out_contract;
       name sender;
@@ -430,119 +1378,616 @@ void oswaps::ontransfer(name from, name to, eosio::asset quantity, string memo)
       asset out_qty;
       string exchange_memo;
       int64_t in_surplus = 0;
-      bool input_is_exact = prep_type == "exprepfrom"_n;
-      if (input_is_exact) {
-        exprepfrom_params efp = unpack<exprepfrom_params>(prep_action.data.data(), prep_action.data.size());
+      bool input_is_exact = prep_type == "exprepfrom"_n || prep_type == "exprepfrom2"_n;
+      if (prep_type == "exroute"_n) {
+        exroute_params erp = unpack<exroute_params>(prep_action.data, prep_action.size);
+        recipient = erp.recipient;
+        sender = erp.sender;
+        exchange_memo = erp.memo;
+        check(erp.path.size() >= 2, "route must have at least two tokens");
+        auto ain = assettable.require_find(erp.path.front(), "unrecog input token id");
+        check(ain->contract_name == tkcontract, "wrong token contract");
+        check(ain->balance.symbol == quantity.symbol, "transfer symbol mismatched to prep");
+        check(erp.in_amount.symbol == quantity.symbol && erp.in_amount.amount == quantity.amount,
+          "transfer qty mismatched to prep");
+        int64_t in_amount64 = quantity.amount;
+
+        // run the legs on in-memory copies of the asset rows, so that each row is
+        //   written at most once and intermediate tokens never leave the contract
+        std::vector<assettypea> rows;
+        auto row = [&](uint64_t token_id) -> size_t {
+          for (size_t i = 0; i < rows.size(); ++i) {
+            if (rows[i].token_id == token_id) { return i; }
+          }
+          rows.push_back(*assettable.require_find(token_id, "unrecog token id in route"));
+          observe(rows.back());
+          return rows.size() - 1;
+        };
+        int64_t amount = in_amount64;
+        size_t in_row = row(erp.path.front());
+        for (size_t leg = 1; leg < erp.path.size(); ++leg) {
+          size_t out_row = row(erp.path[leg]);
+          swap_result sw = compute_swap(rows[in_row], rows[out_row], amount, true);
+          log_swap(sender, recipient, rows[in_row], rows[out_row], sw);
+          rows[in_row].balance.amount = sw.in_bal_after;
+          accrue_fee(rows[in_row], sw.fee);
+          rows[out_row].balance.amount = sw.out_bal_after;
+          amount = sw.out_amount;
+          in_row = out_row;
+        }
+        // intermediate tokens return to the pool, so only the final output is limited
+        rows[in_row].limit.draw(amount, rows[in_row].symbol);
+        const assettypea& aout = rows[in_row];
+        out_contract = aout.contract_name;
+        out_qty = asset(amount, aout.balance.symbol);
+        check(erp.min_out.symbol == aout.balance.symbol, "min_out symbol mismatched to route");
+        check(amount >= erp.min_out.amount, "route output is less than min_out");
+        for (const assettypea& r : rows) {
+          assettable.modify(assettable.find(r.token_id), same_payer, [&](auto& s) {
+            s = r;
+          });
+        }
+
+      } else if (input_is_exact) {
+        exprepfrom2_params efp;
+        if (prep_type == "exprepfrom2"_n) {
+          efp = unpack<exprepfrom2_params>(prep_action.data, prep_action.size);
+        } else {
+          exprepfrom_params sp = unpack<exprepfrom_params>(prep_action.data, prep_action.size);
+          efp = {sp.sender, sp.recipient, sp.in_token_id, sp.out_token_id,
+                 asset(amount_from(quantity.symbol, sp.in_amount), quantity.symbol), sp.memo};
+        }
         recipient = efp.recipient;
         sender = efp.sender;
         exchange_memo = efp.memo;
         auto ain = assettable.require_find(efp.in_token_id, "unrecog input token id");
         check(ain->contract_name == tkcontract, "wrong token contract");
-        check(ain->symbol == quantity.symbol.code(), "transfer symbol mismatched to prep");
-        stats in_stattable(ain->contract_name, ain->symbol.raw());
-        auto stin = in_stattable.require_find(ain->symbol.raw(), "can't stat input symbol");
-        check(ain->active, "input token swap is frozen");
-        uint64_t in_amount64 = amount_from(stin->supply.symbol, efp.in_amount);
-        accounts in_accttable(ain->contract_name, get_self().value);
-        auto acin = in_accttable.require_find(ain->symbol.raw(), "no pool balance after transfer in");
-        // must back out transfer which just occurred
-        uint64_t in_bal_before = acin->balance.amount - quantity.amount;
-        check(in_bal_before > 0, "zero input balance, can't compute swap");                
+        check(ain->balance.symbol == quantity.symbol, "transfer symbol mismatched to prep");
+        check(efp.in_amount.symbol == quantity.symbol && efp.in_amount.amount == quantity.amount,
+          "transfer qty mismatched to prep");
+        int64_t in_amount64 = quantity.amount;
         auto aout = assettable.require_find(efp.out_token_id, "unrecog output token id");
         out_contract = aout->contract_name;
-        stats out_stattable(aout->contract_name, aout->symbol.raw());
-        auto stout = out_stattable.require_find(aout->symbol.raw(), "can't stat output symbol");
-        check(aout->active, "output token swap is frozen");
-        //uint64_t out_amount64 = amount_from(stout->supply);.symbol, efp.out_amount);
-        accounts out_accttable(aout->contract_name, get_self().value);
-        auto acout = out_accttable.find(aout->symbol.raw());
-        uint64_t out_bal_before = 0;
-        if(acout != out_accttable.end()) {
-          out_bal_before = acout->balance.amount;
-        }
 
         // do balancer computation 
-        double lc, lnc;
-        int64_t in_bal_after, out_bal_after, computed_amt;
-        in_bal_after = in_bal_before + in_amount64;
-        lc = log((double)in_bal_after/in_bal_before);
-        lnc = -(ain->weight/aout->weight * lc);
-        out_bal_after = llround(out_bal_before * exp(lnc));
-        computed_amt = out_bal_before - out_bal_after;
-
-        check(in_amount64 == quantity.amount, "transfer qty mismatched to prep");
-        out_qty = asset(computed_amt, stout->supply.symbol);
+        swap_result sw = compute_swap(*ain, *aout, in_amount64, true);
+        if (efp.min_out.has_value()) {
+          check(efp.min_out->symbol == aout->balance.symbol, "min_out symbol mismatched");
+          check(sw.out_amount >= efp.min_out->amount, "swap output is less than min_out");
+        }
+        log_swap(sender, recipient, *ain, *aout, sw);
+        out_qty = asset(sw.out_amount, aout->balance.symbol);
+        assettable.modify(ain, same_payer, [&](auto& s) {
+          observe(s);
+          s.balance.amount = sw.in_bal_after;
+          accrue_fee(s, sw.fee);
+        });
+        assettable.modify(aout, same_payer, [&](auto& s) {
+          observe(s);
+          s.balance.amount = sw.out_bal_after;
+          s.limit.draw(sw.out_amount, s.symbol);
+        });
         
       } else { // output quantity is exact
-        exprepto_params etp = unpack<exprepto_params>(prep_action.data.data(), prep_action.data.size());
+        exprepto2_params etp;
+        bool typed = prep_type == "exprepto2"_n;
+        exprepto_params sp;
+        if (typed) {
+          etp = unpack<exprepto2_params>(prep_action.data, prep_action.size);
+        } else {
+          sp = unpack<exprepto_params>(prep_action.data, prep_action.size);
+          etp = {sp.sender, sp.recipient, sp.in_token_id, sp.out_token_id, asset(), sp.memo};
+        }
         recipient = etp.recipient;
         sender = etp.sender;
         exchange_memo = etp.memo;
         auto ain = assettable.require_find(etp.in_token_id, "unrecog input token id");
         check(ain->contract_name == tkcontract, "wrong token contract");
-        check(ain->symbol == quantity.symbol.code(), "transfer symbol mismatched to prep");
-        stats in_stattable(ain->contract_name, ain->symbol.raw());
-        auto stin = in_stattable.require_find(ain->symbol.raw(), "can't stat symbol");
-        check(ain->active, "input token swap is frozen");
-        //uint64_t in_amount64 = amount_from(stin->supply.symbol, etp.in_amount);
-        accounts in_accttable(ain->contract_name, get_self().value);
-        auto acin = in_accttable.require_find(ain->symbol.raw(), "no pool balance after transfer in");
-        // must back out transfer which just occurred
-        uint64_t in_bal_before = acin->balance.amount - quantity.amount;
-        check(in_bal_before > 0, "zero input balance, can't compute swap");                
+        check(ain->balance.symbol == quantity.symbol, "transfer symbol mismatched to prep");
         auto aout = assettable.require_find(etp.out_token_id, "unrecog output token id");
         out_contract = aout->contract_name;
-        stats out_stattable(aout->contract_name, aout->symbol.raw());
-        auto stout = out_stattable.require_find(aout->symbol.raw(), "can't stat symbol");
-        check(aout->active, "output token swap is frozen");
-        uint64_t out_amount64 = amount_from(stout->supply.symbol, etp.out_amount);
-        accounts out_accttable(aout->contract_name, get_self().value);
-        auto acout = out_accttable.find(aout->symbol.raw());
-        uint64_t out_bal_before = 0;
-        if(acout != out_accttable.end()) {
-          out_bal_before = acout->balance.amount;
+        if (!typed) {
+          etp.out_amount = asset(amount_from(aout->balance.symbol, sp.out_amount),
+                                 aout->balance.symbol);
         }
+        check(etp.out_amount.symbol == aout->balance.symbol, "mismatched symbol");
+        int64_t out_amount64 = etp.out_amount.amount;
 
-        double lc, lnc;
-        int64_t in_bal_after, out_bal_after, computed_amt;
-        out_bal_after = out_bal_before - out_amount64;
-        check(out_bal_after > 0, "insufficient pool bal output token");
-        lc = log((double)out_bal_after/out_bal_before);
-        lnc = -(aout->weight/ain->weight * lc);
-        in_bal_after = llround(in_bal_before * exp(lnc));
-        computed_amt = in_bal_after - in_bal_before;
-        
-        in_surplus = quantity.amount - computed_amt;
+        swap_result sw = compute_swap(*ain, *aout, out_amount64, false);
+        in_surplus = quantity.amount - sw.in_amount;
         check(in_surplus >= 0, "insufficient amount transferred in");
-        out_qty = asset(out_amount64, stout->supply.symbol);
+        if (etp.max_in.has_value()) {
+          check(etp.max_in->symbol == quantity.symbol, "max_in symbol mismatched");
+          check(sw.in_amount <= etp.max_in->amount, "swap input is more than max_in");
+        }
+        out_qty = asset(out_amount64, aout->balance.symbol);
+        log_swap(sender, recipient, *ain, *aout, sw);
+        assettable.modify(ain, same_payer, [&](auto& s) {
+          observe(s);
+          s.balance.amount = sw.in_bal_after;
+          accrue_fee(s, sw.fee);
+        });
+        assettable.modify(aout, same_payer, [&](auto& s) {
+          observe(s);
+          s.balance.amount = sw.out_bal_after;
+          s.limit.draw(sw.out_amount, s.symbol);
+        });
 
       }
     
-      // send exchange output to recipient 
-      action (
-        permission_level{get_self(), "active"_n},
-        out_contract,
-        "transfer"_n,
-        std::make_tuple(get_self(), recipient, out_qty,
-          exchange_memo + " (from " + sender.to_string() + " via oswaps)")
-      ).send();
-      // refund surplus to sender
-      if(in_surplus > 0) {
-        asset overpayment = asset(in_surplus, quantity.symbol);
-        asset netpayment = asset(quantity.amount-in_surplus, quantity.symbol);
-        action (
-          permission_level{get_self(), "active"_n},
-          tkcontract,
-          "transfer"_n,
-          std::make_tuple(get_self(), sender, overpayment,
-            std::string("oswaps exchange refund overpayment, net is ")+netpayment.to_string())
-        ).send();
-      }
+      send_exchange(out_contract, recipient, out_qty, exchange_memo, sender, quantity, in_surplus);
+    }
+}
+
+void oswaps::memo_swap(name from, asset quantity, const string& memo) {
+  // #<op>,<out_token_id>,<recipient>,<amount>
+  check(memo.size() > 3 && memo[2] == ',', "malformed swap memo");
+  std::vector<string> fields;
+  size_t start = 3;
+  for (size_t i = start; i <= memo.size(); ++i) {
+    if (i == memo.size() || memo[i] == ',') {
+      fields.push_back(memo.substr(start, i - start));
+      start = i + 1;
+    }
+  }
+  check(fields.size() == 3, "malformed swap memo");
+  char op = memo[1];
+  check(op == 'F' || op == 'T' || op == 'B', "unrecog swap memo op");
+  uint64_t out_token_id = uint_from(fields[0]);
+  name recipient = fields[1].empty() ? from : name(fields[1]);
+  int64_t limit = int64_t(uint_from(fields[2]));
+  check(limit >= 0, "swap memo amount out of range");
+
+  name tkcontract = get_first_receiver();
+  tokensa assettable(get_self(), get_self().value);
+  auto tokenindex = assettable.get_index<"bytoken"_n>();
+  auto t = tokenindex.find(token_key(tkcontract, quantity.symbol.code()));
+  check(t != tokenindex.end() && t->balance.symbol == quantity.symbol, "unrecog input token");
+  auto ain = assettable.iterator_to(*t);
+  auto aout = assettable.require_find(out_token_id, "unrecog output token id");
+  if (op == 'B') {
+    batchconfs batchconfset(get_self(), get_self().value);
+    uint32_t window = batchconfset.get_or_default(batchconf_row).window;
+    check(window > 0, "batch swaps are not enabled");
+    check(ain->token_id != aout->token_id, "input and output tokens must differ");
+    check(quantity.amount > 0, "transfer quantity must be positive");
+    check(quantity.amount >= ain->balance.amount / intent_min_fraction,
+      "batch intent is below the minimum size");
+    uint32_t now = current_time_point().sec_since_epoch();
+    intents intenttable(get_self(), get_self().value);
+    intenttable.emplace(get_self(), [&](auto& s) {
+      s.id = intenttable.available_primary_key();
+      s.closes = (now / window + 1) * window;
+      s.sender = from;
+      s.recipient = recipient;
+      s.in_contract = tkcontract;
+      s.in_token_id = ain->token_id;
+      s.out_token_id = out_token_id;
+      s.in_amount = quantity;
+      s.min_out = limit;
+    });
+    return;
+  }
+  swap_result sw = compute_swap(*ain, *aout, op == 'F' ? quantity.amount : limit, op == 'F');
+  int64_t in_surplus = 0;
+  if (op == 'F') {
+    check(sw.out_amount >= limit, "swap output is less than min_out");
+  } else {
+    in_surplus = quantity.amount - sw.in_amount;
+    check(in_surplus >= 0, "insufficient amount transferred in");
+  }
+  log_swap(from, recipient, *ain, *aout, sw);
+  assettable.modify(ain, same_payer, [&](auto& s) {
+    observe(s);
+    s.balance.amount = sw.in_bal_after;
+    accrue_fee(s, sw.fee);
+  });
+  assettable.modify(aout, same_payer, [&](auto& s) {
+    observe(s);
+    s.balance.amount = sw.out_bal_after;
+    s.limit.draw(sw.out_amount, s.symbol);
+  });
+  send_exchange(aout->contract_name, recipient, asset(sw.out_amount, aout->balance.symbol),
+    "oswaps exchange", from, quantity, in_surplus);
+}
+
+void oswaps::logswap(swapEvent event) {
+  require_auth(get_self());
+}
+
+void oswaps::logliq(liqEvent event) {
+  require_auth(get_self());
+}
+
+// logs a swap computed on `ain` and `aout` before they are updated
+void oswaps::log_swap(name sender, name recipient, const assettypea& ain, const assettypea& aout,
+                      const swap_result& sw) {
+  swapEvent e{next_event_seq(), sender, recipient, ain.token_id, aout.token_id, sw.in_amount,
+              sw.out_amount, sw.fee, ain.balance.amount, sw.in_bal_after, aout.balance.amount,
+              sw.out_bal_after, ain.weight, aout.weight};
+  action (
+    permission_level{get_self(), "active"_n},
+    get_self(),
+    "logswap"_n,
+    std::make_tuple(e)
+  ).send();
+}
+
+// logs a liquidity change of `before`, the asset row before it is updated
+void oswaps::log_liq(name account, const assettypea& before, int64_t bal_after,
+                     uint64_t weight_after) {
+  liqEvent e{next_event_seq(), account, before.token_id, bal_after - before.balance.amount,
+             before.balance.amount, bal_after, before.weight, weight_after};
+  action (
+    permission_level{get_self(), "active"_n},
+    get_self(),
+    "logliq"_n,
+    std::make_tuple(e)
+  ).send();
+}
+
+uint64_t oswaps::next_event_seq() {
+  if (!event_seq_loaded) {
+    eventseqs eventseqset(get_self(), get_self().value);
+    event_seq = eventseqset.get_or_default(eventseq_row);
+    event_seq_loaded = true;
+  }
+  return ++event_seq.last;
+}
+
+oswaps::~oswaps() {
+  if (event_seq_loaded) {
+    eventseqs eventseqset(get_self(), get_self().value);
+    eventseqset.set(event_seq, get_self());
+  }
+}
+
+void oswaps::memo_deposit(name from, asset quantity, const string& memo) {
+  // #D[,<recipient>]
+  check(memo.size() == 2 || memo[2] == ',', "malformed deposit memo");
+  name recipient = memo.size() > 3 ? name(memo.substr(3)) : from;
+  check(is_account(recipient), "recipient account does not exist");
+  check(quantity.amount > 0, "transfer quantity must be positive");
+  tokensa assettable(get_self(), get_self().value);
+  auto tokenindex = assettable.get_index<"bytoken"_n>();
+  auto t = tokenindex.find(token_key(get_first_receiver(), quantity.symbol.code()));
+  check(t != tokenindex.end() && t->balance.symbol == quantity.symbol, "unrecog input token");
+  // a notification cannot bill RAM to the sender, so the contract pays for new rows;
+  //   only the sender's own may be created, at most one per token
+  if (recipient != from) {
+    deposits deptable(get_self(), recipient.value);
+    check(deptable.find(t->token_id) != deptable.end(), "recipient has no deposit of this token");
+  }
+  add_deposit(recipient, *t, quantity.amount, get_self());
+  tokenindex.modify(t, same_payer, [&](auto& s) {
+    s.deposits += quantity;
+  });
+}
+
+// credits an internal deposit balance; the asset's deposit total is the caller's
+void oswaps::add_deposit(name account, const assettypea& a, int64_t amount, name ram_payer) {
+  deposits deptable(get_self(), account.value);
+  auto d = deptable.find(a.token_id);
+  if (d == deptable.end()) {
+    deptable.emplace(ram_payer, [&](auto& s) {
+      s.token_id = a.token_id;
+      s.balance = asset(amount, a.balance.symbol);
+    });
+  } else {
+    deptable.modify(d, same_payer, [&](auto& s) {
+      s.balance.amount += amount;
+    });
+  }
+}
+
+// debits an internal deposit balance, erasing it once empty; the asset's deposit total
+//   is the caller's
+void oswaps::sub_deposit(name account, const assettypea& a, int64_t amount) {
+  deposits deptable(get_self(), account.value);
+  auto d = deptable.find(a.token_id);
+  check(d != deptable.end() && d->balance.amount >= amount, "insufficient deposit");
+  if (d->balance.amount == amount) {
+    deptable.erase(d);
+  } else {
+    deptable.modify(d, same_payer, [&](auto& s) {
+      s.balance.amount -= amount;
+    });
+  }
+}
+
+void oswaps::send_exchange(name out_contract, name recipient, asset out_qty,
+                           const string& memo, name sender, asset in_qty, int64_t in_surplus) {
+  // send exchange output to recipient 
+  action (
+    permission_level{get_self(), "active"_n},
+    out_contract,
+    "transfer"_n,
+    std::make_tuple(get_self(), recipient, out_qty,
+      memo + " (from " + sender.to_string() + " via oswaps)")
+  ).send();
+  // refund surplus to sender
+  if(in_surplus > 0) {
+    asset overpayment = asset(in_surplus, in_qty.symbol);
+    asset netpayment = asset(in_qty.amount-in_surplus, in_qty.symbol);
+    action (
+      permission_level{get_self(), "active"_n},
+      get_first_receiver(),
+      "transfer"_n,
+      std::make_tuple(get_self(), sender, overpayment,
+        std::string("oswaps exchange refund overpayment, net is ")+netpayment.to_string())
+    ).send();
+  }
+}
+
+void oswaps::add_payment(std::vector<payment>& payments, name contract, name to,
+                         asset quantity) {
+  if (quantity.amount == 0) {
+    return;
+  }
+  for (payment& p : payments) {
+    if (p.contract == contract && p.to == to && p.quantity.symbol == quantity.symbol) {
+      p.quantity += quantity;
+      return;
+    }
+  }
+  payments.push_back({contract, to, quantity});
+}
+
+// The net amount d of token a, out of a_total offered for token b against b_total
+//   offered for token a, which the pool exchanges when all are cleared at one price:
+//   the pool pays f(d) for d, and the remaining a_total - d is matched with b_total,
+//   so a uniform price requires f(d) * (a_total - d) = b_total * d. The left side is
+//   concave, so this is the largest d where it is not less than the right side.
+int64_t oswaps::net_batch_flow(const assettypea& a, const assettypea& b,
+                               int64_t a_total, int64_t b_total) {
+  if (a_total == 0 || b_total == 0) {
+    return a_total;
+  }
+  int64_t lo = 0;
+  int64_t hi = a_total;
+  while (lo < hi) {
+    int64_t mid = lo + (hi - lo + 1)/2;
+    int64_t out = compute_swap(a, b, mid, true).out_amount;
+    if (oswaps_math::uint128(out) * (a_total - mid) >= oswaps_math::uint128(b_total) * mid) {
+      lo = mid;
     } else {
-      check(false, "malformed oswaps trx: invalid prep action");
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
+
+void oswaps::clear_pair(assettypea& x, assettypea& y, std::vector<intent>& batch,
+                        std::vector<payment>& payments) {
+  // a pair which cannot be exchanged is refunded rather than blocking settlement
+  bool tradable = x.active && y.active && x.weight > 0 && y.weight > 0
+                  && x.balance.amount > 0 && y.balance.amount > 0;
+  while (!batch.empty()) {
+    int64_t x_total = 0; // offered for y
+    int64_t y_total = 0; // offered for x
+    for (const intent& i : batch) {
+      (i.in_token_id == x.token_id ? x_total : y_total) += i.in_amount.amount;
+    }
+    swap_result sw = {};
+    int64_t x_net = tradable ? net_batch_flow(x, y, x_total, y_total) : 0;
+    int64_t y_net = tradable && x_net == 0 ? net_batch_flow(y, x, y_total, x_total) : 0;
+    int64_t y_for_x = y_total; // paid out to the x sellers
+    int64_t x_for_y = x_total; // paid out to the y sellers
+    if (x_net > 0) {
+      sw = compute_swap(x, y, x_net, true);
+      y_for_x += sw.out_amount;
+      x_for_y -= x_net;
+    } else if (y_net > 0) {
+      sw = compute_swap(y, x, y_net, true);
+      x_for_y += sw.out_amount;
+      y_for_x -= y_net;
+    }
+    // the pool output must also be within the rate limit of its token
+    assettypea& pool_out = x_net > 0 ? y : x;
+    if (!tradable || (x_net + y_net > 0 && sw.out_amount > pool_out.limit.available())) {
+      for (const intent& i : batch) {
+        add_payment(payments, i.in_contract, i.sender, i.in_amount);
+      }
+      return;
+    }
+    // pro rata shares, rounded down; the remainder stays in the pool
+    std::vector<int64_t> outs;
+    std::vector<intent> kept;
+    int64_t x_paid = 0;
+    int64_t y_paid = 0;
+    for (const intent& i : batch) {
+      bool x_seller = i.in_token_id == x.token_id;
+      int64_t out = int64_t(oswaps_math::uint128(i.in_amount.amount) * (x_seller ? y_for_x : x_for_y)
+                            / (x_seller ? x_total : y_total));
+      if (out < i.min_out) {
+        add_payment(payments, i.in_contract, i.sender, i.in_amount);
+        continue;
+      }
+      kept.push_back(i);
+      outs.push_back(out);
+      (x_seller ? y_paid : x_paid) += out;
+    }
+    if (kept.size() < batch.size()) { // clear again without the refunded intents
+      batch.swap(kept);
+      continue;
+    }
+    assettypea x_before = x;
+    assettypea y_before = y;
+    x.balance.amount += x_total - x_paid;
+    y.balance.amount += y_total - y_paid;
+    if (x_net > 0) {
+      x.balance.amount -= sw.fee;
+      accrue_fee(x, sw.fee);
+      y.limit.draw(sw.out_amount, y.symbol);
+    } else if (y_net > 0) {
+      y.balance.amount -= sw.fee;
+      accrue_fee(y, sw.fee);
+      x.limit.draw(sw.out_amount, x.symbol);
+    }
+    // the logged balances include the matched flows and the rounding remainders
+    if (x_net > 0) {
+      sw.in_bal_after = x.balance.amount;
+      sw.out_bal_after = y.balance.amount;
+      log_swap(get_self(), get_self(), x_before, y_before, sw);
+    } else if (y_net > 0) {
+      sw.in_bal_after = y.balance.amount;
+      sw.out_bal_after = x.balance.amount;
+      log_swap(get_self(), get_self(), y_before, x_before, sw);
+    }
+    for (size_t n = 0; n < batch.size(); ++n) {
+      const assettypea& out_token = batch[n].in_token_id == x.token_id ? y : x;
+      add_payment(payments, out_token.contract_name, batch[n].recipient,
+                  asset(outs[n], out_token.balance.symbol));
+    }
+    return;
+  }
+}
+
+oswaps::swap_result oswaps::compute_swap(const assettypea& ain, const assettypea& aout,
+                                         int64_t amount, bool exact_in) {
+  check(ain.token_id != aout.token_id, "input and output tokens must differ");
+  check(ain.active, "input token swap is frozen");
+  check(aout.active, "output token swap is frozen");
+  check(amount >= 0, "swap amount must be positive");
+  int64_t in_bal_before = ain.balance.amount;
+  int64_t out_bal_before = aout.balance.amount;
+  check(in_bal_before > 0, "zero input balance, can't compute swap");
+  check(ain.weight > 0 && aout.weight > 0, "zero weight, can't compute swap");
+  swap_result rv;
+  // the fee is taken from the input, rounded up, and does not enter the pool
+  if (exact_in) {
+    rv.in_amount = amount;
+    rv.fee = int64_t((oswaps_math::uint128(amount) * ain.fee_rate + weight_one - 1) / weight_one);
+    rv.in_bal_after = in_bal_before + amount - rv.fee;
+    rv.out_bal_after = oswaps_math::out_bal_after_in(in_bal_before, ain.weight,
+      out_bal_before, aout.weight, amount - rv.fee);
+    rv.out_amount = out_bal_before - rv.out_bal_after;
+  } else {
+    rv.out_amount = amount;
+    rv.out_bal_after = out_bal_before - amount;
+    check(rv.out_bal_after > 0, "insufficient pool bal output token");
+    rv.in_bal_after = oswaps_math::in_bal_after_out(in_bal_before, ain.weight,
+      out_bal_before, aout.weight, amount);
+    check(rv.in_bal_after >= 0, "swap too large");
+    int64_t net = rv.in_bal_after - in_bal_before;
+    oswaps_math::uint128 gross = (oswaps_math::uint128(net) * weight_one
+      + (weight_one - ain.fee_rate) - 1) / (weight_one - ain.fee_rate);
+    check(gross < (uint64_t(1) << 62), "swap too large");
+    rv.in_amount = int64_t(gross);
+    rv.fee = rv.in_amount - net;
+  }
+  return rv;
+}
+
+// advances the price accumulator of `a` to now, before its balance or weight changes
+void oswaps::observe(assettypea& a) {
+  uint32_t now = current_time_point().sec_since_epoch();
+  if (now <= a.price_updated) {
+    return;
+  }
+  a.price_cum += log_price(a.balance.amount, a.weight) * (now - a.price_updated);
+  bool checkpoint = now / checkpoint_interval != a.price_updated / checkpoint_interval;
+  a.price_updated = now;
+  if (!checkpoint) {
+    return;
+  }
+  pricerings ringtable(get_self(), get_self().value);
+  uint64_t slot = now / checkpoint_interval % checkpoint_slots;
+  auto record = [&](auto& s) {
+    s.token_id = a.token_id;
+    if (s.ring.size() <= slot) {
+      s.ring.resize(slot + 1);
     }
+    s.ring[slot] = {now, a.price_cum};
+  };
+  auto r = ringtable.find(a.token_id);
+  if (r == ringtable.end()) {
+    ringtable.emplace(get_self(), record);
+  } else {
+    ringtable.modify(r, same_payer, record);
+  }
+}
+
+// the price accumulator of `a` at `time`, interpolated between checkpoints if before
+//   its last change
+uint128_t oswaps::price_cum_at(const assettypea& a, uint32_t time) {
+  if (time >= a.price_updated) {
+    return a.price_cum + log_price(a.balance.amount, a.weight) * (time - a.price_updated);
+  }
+  // the checkpoints around `time`; the asset row itself is the latest
+  price_checkpoint before{0, 0};
+  price_checkpoint after{a.price_updated, a.price_cum};
+  pricerings ringtable(get_self(), get_self().value);
+  auto r = ringtable.find(a.token_id);
+  if (r != ringtable.end()) {
+    for (const price_checkpoint& c : r->ring) {
+      if (c.time <= time && c.time > before.time) {
+        before = c;
+      }
+      if (c.time >= time && c.time < after.time) {
+        after = c;
+      }
+    }
+  }
+  check(before.time > 0, "time is before the oldest price checkpoint");
+  if (before.time == time || after.time == before.time) {
+    return before.price_cum;
+  }
+  __int128 delta = __int128(after.price_cum - before.price_cum);
+  return before.price_cum + uint128_t(delta * (time - before.time) / (after.time - before.time));
+}
 
-    txset.remove();
+void oswaps::accrue_fee(assettypea& a, int64_t fee) {
+  if (fee == 0) {
+    return;
+  }
+  stats lstatstable(get_self(), a.liq_symbol.code().raw());
+  const auto& lst = lstatstable.get(a.liq_symbol.code().raw(), "no liquidity token");
+  if (lst.supply.amount == 0) { // nobody to pay, so the pool keeps it
+    a.balance.amount += fee;
+    return;
+  }
+  a.fee_growth += oswaps_math::ratio(fee, lst.supply.amount);
+  a.fees.amount += fee;
+}
+
+// settled fees plus those accrued on the current LIQ balance since settlement
+int64_t oswaps::earned_fees(name owner, const assettypea& a) {
+  lpfees feetable(get_self(), owner.value);
+  auto f = feetable.find(a.token_id);
+  oswaps_math::uint128 last = f == feetable.end() ? 0 : f->fee_growth;
+  int64_t owed = f == feetable.end() ? 0 : f->owed;
+  accounts acnts(get_self(), owner.value);
+  auto ac = acnts.find(a.liq_symbol.code().raw());
+  if (ac == acnts.end() || ac->balance.amount == 0 || a.fee_growth == last) {
+    return owed;
+  }
+  oswaps_math::uint128 accrued = oswaps_math::mul(
+    oswaps_math::uint128(ac->balance.amount) << 64, a.fee_growth - last) >> 64;
+  check(accrued <= uint64_t(a.fees.amount), "fee accounting overflow");
+  return owed + int64_t(accrued);
+}
+
+void oswaps::settle_fees(name owner, const assettypea& a, name ram_payer) {
+  lpfees feetable(get_self(), owner.value);
+  auto f = feetable.find(a.token_id);
+  if (f == feetable.end()) {
+    if (a.fee_growth == 0) { // no fees yet, and a missing row means zero growth
+      return;
+    }
+    int64_t owed = earned_fees(owner, a);
+    feetable.emplace(ram_payer, [&](auto& s) {
+      s.token_id = a.token_id;
+      s.fee_growth = a.fee_growth;
+      s.owed = owed;
+    });
+  } else if (f->fee_growth != a.fee_growth) {
+    int64_t owed = earned_fees(owner, a);
+    feetable.modify(f, same_payer, [&](auto& s) {
+      s.fee_growth = a.fee_growth;
+      s.owed = owed;
+    });
+  }
 }
 
 void oswaps::sub_balance( const name& owner, const asset& value ) {
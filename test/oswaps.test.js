@@ -82,11 +82,11 @@ const empty = async( account, tokenaccount) => {
   await addActorPermission(oswaps, 'active', oswaps, 'eosio.code')
 
   console.log('reset')
-  await contracts.oswaps.reset( { authorization: `${oswaps}@owner` })
+  await contracts.oswaps.reset( 1000, { authorization: `${oswaps}@owner` })
   console.log('reset liq token accounts')
-  await contracts.oswaps.resetacct( owner, { authorization: `${oswaps}@owner` })
-  await contracts.oswaps.resetacct( oswaps, { authorization: `${oswaps}@owner` })
-  await contracts.oswaps.resetacct( firstuser, { authorization: `${oswaps}@owner` })
+  await contracts.oswaps.resetacct( owner, 1000, { authorization: `${oswaps}@owner` })
+  await contracts.oswaps.resetacct( oswaps, 1000, { authorization: `${oswaps}@owner` })
+  await contracts.oswaps.resetacct( firstuser, 1000, { authorization: `${oswaps}@owner` })
   console.log('sending oswaps token balances back to owner')
   await empty(oswaps, accounts.token)
   await empty(oswaps, accounts.testtoken)
@@ -537,7 +537,7 @@ const empty = async( account, tokenaccount) => {
 
  
   console.log('reset')
-  await contracts.oswaps.reset( { authorization: `${oswaps}@owner` })
+  await contracts.oswaps.reset( 1000, { authorization: `${oswaps}@owner` })
 
 
 })
@@ -0,0 +1,206 @@
+const { Blockchain, nameToBigInt, symbolCodeToBigInt } = require("@proton/vert");
+const { Transaction, Action, Serializer, PermissionLevel } = require("@greymass/eosio");
+const { assert } = require("chai");
+const fs = require("fs");
+const path = require("path");
+
+/* Resource cost benchmark, skipped unless OSWAPS_BENCH is set:
+ *
+ *   OSWAPS_BENCH=1 npm test
+ *
+ * Environment:
+ *   OSWAPS_BENCH_ITERATIONS     operations of each type per pool size (default 1000)
+ *   OSWAPS_BENCH_SIZES          comma-separated pool sizes (default 2,10,50,200)
+ *   OSWAPS_BENCH_REPORT         report path (default build/bench.json)
+ *   OSWAPS_BENCH_BASELINE       earlier report to compare against (optional)
+ *   OSWAPS_BENCH_THRESHOLD      allowed NET and RAM growth over the baseline (default 0.10)
+ *   OSWAPS_BENCH_CPU_THRESHOLD  allowed CPU growth over the baseline (default 0.25)
+ *
+ * Vert does not bill resources the way nodeos does, so the figures are
+ * estimates for budgeting and regression checks:
+ *   cpu_us     wall-clock time of applyTransaction
+ *   net_bytes  size of the packed transaction, without signatures
+ *   ram_bytes  change in packed row bytes, plus 112 bytes per row, over the
+ *              tables the benchmark touches
+ */
+const env = process.env
+const iterations = parseInt(env.OSWAPS_BENCH_ITERATIONS || '1000')
+const sizes = (env.OSWAPS_BENCH_SIZES || '2,10,50,200').split(',').map((s) => parseInt(s))
+const reportPath = env.OSWAPS_BENCH_REPORT || 'build/bench.json'
+const threshold = parseFloat(env.OSWAPS_BENCH_THRESHOLD || '0.10')
+const cpuThreshold = parseFloat(env.OSWAPS_BENCH_CPU_THRESHOLD || '0.25')
+const rowOverhead = 112
+
+const blockchain = new Blockchain()
+const oswaps = blockchain.createContract('oswaps', 'build/oswaps')
+const token = blockchain.createContract('token', 'build/token')
+const holders = ['oswaps', 'lp', 'trader']
+
+function tokenSymbol(i) {
+    let code = 'T'
+    for (let d = 0; d < 4; ++d, i = Math.floor(i / 26)) {
+        code += String.fromCharCode(65 + i % 26)
+    }
+    return code
+}
+
+/* mirrors liq_code_raw in src/oswaps.cpp */
+function liqSymbol(token_id) {
+    let code = String.fromCharCode(65 + token_id % 26)
+    while (token_id >= 26) {
+        token_id = Math.floor(token_id / 26) - 1
+        code = String.fromCharCode(65 + token_id % 26) + code
+    }
+    return 'LIQ' + code
+}
+
+function quantity(i, units) {
+    return `${units}.0000 ${tokenSymbol(i)}`
+}
+
+function action(contract, actor, name, object) {
+    return Action.from({
+      authorization: [PermissionLevel.from({ actor: actor, permission: 'active' })],
+      account: contract.name,
+      name: name,
+      data: Serializer.encode({ abi: contract.abi, type: name, object: object }).array,
+    })
+}
+
+function transferAction(from, to, quantity) {
+    return action(token, from, 'transfer', { from: from, to: to, quantity: quantity, memo: '' })
+}
+
+function transaction(actions) {
+    return Transaction.from({ expiration: 0, ref_block_num: 0, ref_block_prefix: 0, actions: actions })
+}
+
+function tableBytes(contract, table, scope) {
+    const type = contract.abi.tables.find((t) => String(t.name) == table).type
+    return contract.tables[table](scope).getTableRows().reduce((bytes, row) =>
+      bytes + Serializer.encode({ abi: contract.abi, type: type, object: row }).array.length
+        + rowOverhead, 0)
+}
+
+function ramBytes(n) {
+    let bytes = tableBytes(oswaps, 'configs', nameToBigInt('oswaps'))
+      + tableBytes(oswaps, 'tokensa', nameToBigInt('oswaps'))
+      + tableBytes(oswaps, 'chains', nameToBigInt('oswaps'))
+      + tableBytes(oswaps, 'pricerings', nameToBigInt('oswaps'))
+      + tableBytes(oswaps, 'eventseqs', nameToBigInt('oswaps'))
+    for (let id = 1; id <= n; ++id) {
+        bytes += tableBytes(oswaps, 'stat', symbolCodeToBigInt(liqSymbol(id)))
+    }
+    for (const holder of holders) {
+        bytes += tableBytes(oswaps, 'accounts', nameToBigInt(holder))
+          + tableBytes(token, 'accounts', nameToBigInt(holder))
+    }
+    return bytes
+}
+
+/* a pool of n tokens, each with liquidity 1000000 and weight 1.0 */
+async function setupPool(n) {
+    blockchain.resetTables()
+    await blockchain.createAccounts('manager', 'lp', 'trader')
+    await oswaps.actions.init(['manager', 'Telos']).send('oswaps@owner')
+    for (let i = 0; i < n; ++i) {
+        const id = i + 1
+        await token.actions.create(['lp', quantity(i, 100000000)]).send('token@active')
+        await token.actions.issue(['lp', quantity(i, 100000000), '']).send('lp@active')
+        await token.actions.transfer(['lp', 'trader', quantity(i, 1000000), '']).send('lp@active')
+        await oswaps.actions.createasseta(['lp', 'Telos', 'token', tokenSymbol(i), '']).send('lp@active')
+        await oswaps.actions.unfreeze(['manager', id, tokenSymbol(i)]).send('manager@active')
+        await blockchain.applyTransaction(transaction([
+          action(oswaps, 'lp', 'addliqprep2',
+                 { account: 'lp', token_id: id, amount: quantity(i, 1000000), weight: 1.0 }),
+          transferAction('lp', 'oswaps', quantity(i, 1000000)) ]))
+        await oswaps.actions.unfreeze(['manager', id, tokenSymbol(i)]).send('manager@active')
+    }
+}
+
+/* distinct token indexes for iteration i */
+function pair(n, i) {
+    const a = i % n
+    return [a, (a + 1 + Math.floor(i / n) % (n - 1)) % n]
+}
+
+const operations = {
+    swap: (n, i) => {
+        const [a, b] = pair(n, i)
+        return [ action(oswaps, 'trader', 'exprepfrom2', { sender: 'trader', recipient: 'trader',
+                   in_token_id: a + 1, out_token_id: b + 1, in_amount: quantity(a, 1), memo: '' }),
+                 transferAction('trader', 'oswaps', quantity(a, 1)) ]
+    },
+    addliq: (n, i) => {
+        const a = i % n
+        return [ action(oswaps, 'lp', 'addliqprep2',
+                   { account: 'lp', token_id: a + 1, amount: quantity(a, 1), weight: 0.0 }),
+                 transferAction('lp', 'oswaps', quantity(a, 1)) ]
+    },
+    withdraw: (n, i) => {
+        const a = i % n
+        return [ action(oswaps, 'manager', 'withdraw2',
+                   { account: 'lp', token_id: a + 1, amount: quantity(a, 1), weight: 0.0 }) ]
+    },
+}
+
+async function measure(n, operation) {
+    let cpu = BigInt(0)
+    let net = 0
+    const ram = ramBytes(n)
+    for (let i = 0; i < iterations; ++i) {
+        const trx = transaction(operation(n, i))
+        net += Serializer.encode({ object: trx }).array.length
+        const start = process.hrtime.bigint()
+        await blockchain.applyTransaction(trx)
+        cpu += process.hrtime.bigint() - start
+    }
+    return { iterations: iterations,
+             cpu_us: Number(cpu) / 1000 / iterations,
+             net_bytes: net / iterations,
+             ram_bytes: (ramBytes(n) - ram) / iterations }
+}
+
+/* regressions of report against baseline, as readable strings */
+function regressions(report, baseline) {
+    const found = []
+    for (const size of Object.keys(report.pools)) {
+        for (const [op, result] of Object.entries(report.pools[size])) {
+            const base = baseline.pools[size] && baseline.pools[size][op]
+            if (!base) {
+                continue
+            }
+            for (const [metric, limit] of [['cpu_us', cpuThreshold], ['net_bytes', threshold],
+                                           ['ram_bytes', threshold]]) {
+                if (result[metric] > base[metric] + Math.abs(base[metric]) * limit) {
+                    found.push(`${op}/${size} ${metric}: ${result[metric].toFixed(1)}`
+                               + ` vs baseline ${base[metric].toFixed(1)}`)
+                }
+            }
+        }
+    }
+    return found
+}
+
+(env.OSWAPS_BENCH ? describe : describe.skip)('Oswaps benchmark', function () {
+    this.timeout(0)
+    it('stays within the resource baseline', async () => {
+        const report = { iterations: iterations, pools: {} }
+        for (const n of sizes) {
+            report.pools[n] = {}
+            for (const [op, operation] of Object.entries(operations)) {
+                await setupPool(n)
+                const result = await measure(n, operation)
+                report.pools[n][op] = result
+                console.log(`${op}/${n}: ${result.cpu_us.toFixed(0)} us, ${result.net_bytes} NET bytes,`
+                            + ` ${result.ram_bytes.toFixed(1)} RAM bytes`)
+            }
+        }
+        fs.mkdirSync(path.dirname(reportPath), { recursive: true })
+        fs.writeFileSync(reportPath, JSON.stringify(report, null, 2) + '\n')
+        if (env.OSWAPS_BENCH_BASELINE) {
+            const baseline = JSON.parse(fs.readFileSync(env.OSWAPS_BENCH_BASELINE, 'utf8'))
+            assert.deepEqual(regressions(report, baseline), [])
+        }
+    });
+})
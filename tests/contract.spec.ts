@@ -1,6 +1,6 @@
 const { Blockchain, nameToBigInt, symbolCodeToBigInt, addInlinePermission,
         expectToThrow, } = require("@proton/vert");
-const { Asset, TimePoint, Transaction, Action, Name, Serializer, PermissionLevel } = require("@greymass/eosio");
+const { Asset, TimePoint, TimePointSec, Transaction, Action, Name, Serializer, PermissionLevel } = require("@greymass/eosio");
 const { assert, expect } = require("chai");
 const blockchain = new Blockchain()
 
@@ -96,6 +96,73 @@ function expreptoAction(contract, sender, recipient, in_token_id, out_token_id,
     })
 }
 
+async function setupPool() {
+    await oswaps.actions.init(['manager', 'Telos']).send('oswaps@owner')
+    await oswaps.actions.createasseta(['issuera', 'Telos', 'token', 'AZURES', '']).send('issuera@active')
+    await oswaps.actions.createasseta(['issuerb', 'Telos', 'token', 'BURGS', '']).send('issuerb@active')
+    await oswaps.actions.unfreeze(['manager', 1, 'AZURES']).send('manager@active')
+    await oswaps.actions.unfreeze(['manager', 2, 'BURGS']).send('manager@active')
+    await blockchain.applyTransaction(Transaction.from({
+      expiration: 0, ref_block_num: 0, ref_block_prefix: 0,
+      actions: [ addliqprepAction( oswaps, 'issuera', 1, '1000.0000 AZURES', 1.00),
+                 transferAction(token, 'issuera', 'oswaps', '1000.0000 AZURES', '') ]
+    }))
+    await blockchain.applyTransaction(Transaction.from({
+      expiration: 0, ref_block_num: 0, ref_block_prefix: 0,
+      actions: [ addliqprepAction( oswaps, 'issuerb', 2, '1000.0000 BURGS', 1.00),
+                 transferAction(token, 'issuerb', 'oswaps', '1000.0000 BURGS', '') ]
+    }))
+    await oswaps.actions.unfreeze(['manager', 1, 'AZURES']).send('manager@active')
+    await oswaps.actions.unfreeze(['manager', 2, 'BURGS']).send('manager@active')
+    await token.actions.transfer(['issuerb', 'bob', '1000.0000 BURGS', '']).send('issuerb')
+}
+
+function prepAction(contract, actor, action, object) {
+    return Action.from({
+      authorization: [{
+        actor: actor,
+        permission: 'active',
+      }],
+      account: contract.name,
+      name: action,
+      data: Serializer.encode({
+        abi: contract.abi,
+        type: action,
+        object: object,
+      }).array,
+    })
+}
+
+function exrouteAction(contract, sender, recipient, path, in_amount, min_out, memo) {
+    return Action.from({
+      authorization: [{
+        actor: sender,
+        permission: 'active',
+      }],
+      account: contract.name,
+      name: 'exroute',
+      data: Serializer.encode({
+        abi: contract.abi,
+        type: 'exroute',
+        object: { sender: sender, recipient: recipient, path: path,
+          in_amount: in_amount, min_out: min_out, memo: memo },
+      }).array,
+    })
+}
+
+async function addThirdToken() {
+    await token2.actions.create(['user3', '1000000.00 CASH']).send('token2@active')
+    await token2.actions.issue(['user3', '1000000.00 CASH', 'issue some']).send('user3@active')
+    await oswaps.actions.createasseta(['user3', 'Telos', 'token2', 'CASH', '']).send('user3@active')
+    await oswaps.actions.unfreeze(['manager', 3, 'CASH']).send('manager@active')
+    await blockchain.applyTransaction(Transaction.from({
+      expiration: 0, ref_block_num: 0, ref_block_prefix: 0,
+      actions: [ addliqprepAction( oswaps, 'user3', 3, '2000.00 CASH', 1.00),
+                 transferAction(token2, 'user3', 'oswaps', '2000.00 CASH', '') ]
+    }))
+    await oswaps.actions.unfreeze(['manager', 3, 'CASH']).send('manager@active')
+}
+
 /* Runs before each test */
 beforeEach(async () => {
     blockchain.resetTables()
@@ -128,12 +195,20 @@ describe('Oswaps', () => {
         console.log('create assets')
         await oswaps.actions.createasseta(['issuera', 'Telos', 'token', 'AZURES', '']).send('issuera@active')
         await oswaps.actions.createasseta(['issuerb', 'Telos', 'token', 'BURGS', '']).send('issuerb@active')
-        rows = oswaps.tables.assetsa(nameToBigInt('oswaps')).getTableRows()
+        rows = oswaps.tables.tokensa(nameToBigInt('oswaps')).getTableRows()
         assert.deepEqual(rows, [ 
-            { token_id: 1, chain_code: '4667b205c6838ef70ff7988f6e8257e8be0e1284a2f59699054a018f743b1d11',
-              contract_name: 'token', symbol: 'AZURES', active: false, metadata: '', weight: '0.0000000' },
-            { token_id: 2, chain_code: '4667b205c6838ef70ff7988f6e8257e8be0e1284a2f59699054a018f743b1d11',
-              contract_name: 'token', symbol: 'BURGS', active: false, metadata: '', weight: '0.0000000' } ] )
+            { token_id: 1, chain: 0,
+              contract_name: 'token', symbol: 'AZURES', active: false, weight: 0,
+              balance: '0.0000 AZURES', liq_symbol: '4,LIQB',
+              fee_rate: 0, fee_growth: '0', fees: '0.0000 AZURES',
+              limit: { capacity: 0, refill: 0, level: 0, updated: 0 },
+              deposits: '0.0000 AZURES', price_cum: '0', price_updated: 0 },
+            { token_id: 2, chain: 0,
+              contract_name: 'token', symbol: 'BURGS', active: false, weight: 0,
+              balance: '0.0000 BURGS', liq_symbol: '4,LIQC',
+              fee_rate: 0, fee_growth: '0', fees: '0.0000 BURGS',
+              limit: { capacity: 0, refill: 0, level: 0, updated: 0 },
+              deposits: '0.0000 BURGS', price_cum: '0', price_updated: 0 } ] )
 
         console.log('unfreeze assets')
         await oswaps.actions.unfreeze(['manager', 1, 'AZURES']).send('manager@active')
@@ -208,8 +283,8 @@ describe('Oswaps', () => {
         rvstruct = JSON.parse(JSON.stringify(rv))
         assert.deepEqual(rvstruct,
           { status_entries: [
-            { token_id: 1, balance: '5.0000 AZURES', weight: '0.5000000' },
-            { token_id: 2, balance: '10.0000 BURGS', weight: '1.0000000' }
+            { token_id: 1, balance: '5.0000 AZURES', weight: 500000000 },
+            { token_id: 2, balance: '10.0000 BURGS', weight: 1000000000 }
         ]})
         console.log('unfreeze BURGS')
         await oswaps.actions.unfreeze(['manager', 2, 'BURGS']).send('manager@active')
@@ -224,10 +299,10 @@ describe('Oswaps', () => {
           out_amount = 0.2000
           out_bal_after = out_bal_before - out_amount
           lc = Math.log(out_bal_after/out_bal_before)
-          out_weight = parseFloat(rvstruct.status_entries.filter((e)=>e.token_id==out_token)[0]
-            .weight.split(' ')[0])
-          in_weight = parseFloat(rvstruct.status_entries.filter((e)=>e.token_id==in_token)[0]
-            .weight.split(' ')[0])
+          out_weight = Number(rvstruct.status_entries.filter((e)=>e.token_id==out_token)[0]
+            .weight)
+          in_weight = Number(rvstruct.status_entries.filter((e)=>e.token_id==in_token)[0]
+            .weight)
           lnc = -out_weight/in_weight * lc
           in_bal_before = parseFloat(rvstruct.status_entries.filter((e)=>e.token_id==in_token)[0]
             .balance.split(' ')[0])
@@ -263,10 +338,10 @@ describe('Oswaps', () => {
           in_amount = 0.2500
           in_bal_after = in_bal_before + in_amount
           lc = Math.log(in_bal_after/in_bal_before)
-          out_weight = parseFloat(rvstruct.status_entries.filter((e)=>e.token_id==out_token)[0]
-            .weight.split(' ')[0])
-          in_weight = parseFloat(rvstruct.status_entries.filter((e)=>e.token_id==in_token)[0]
-            .weight.split(' ')[0])
+          out_weight = Number(rvstruct.status_entries.filter((e)=>e.token_id==out_token)[0]
+            .weight)
+          in_weight = Number(rvstruct.status_entries.filter((e)=>e.token_id==in_token)[0]
+            .weight)
           lnc = -in_weight/out_weight * lc
           out_bal_before = parseFloat(rvstruct.status_entries.filter((e)=>e.token_id==out_token)[0]
             .balance.split(' ')[0])
@@ -300,17 +375,359 @@ describe('Oswaps', () => {
                      transferAction(token, 'issuera', 'oswaps', '4.5732 AZURES', 'yep') ] 
         }))
         //console.log(blockchain.console)
-        rows = oswaps.tables.assetsa(nameToBigInt('oswaps')).getTableRows()
+        rows = oswaps.tables.tokensa(nameToBigInt('oswaps')).getTableRows()
+        // price accumulators follow the chain's clock
+        for (const row of rows) {
+            assert.notEqual(row.price_updated, 0)
+            delete row.price_cum
+            delete row.price_updated
+        }
         assert.deepEqual(rows, [ 
-            { token_id: 1, chain_code: '4667b205c6838ef70ff7988f6e8257e8be0e1284a2f59699054a018f743b1d11',
-              contract_name: 'token', symbol: 'AZURES', active: true, metadata: '', weight: '1.0000000' },
-            { token_id: 2, chain_code: '4667b205c6838ef70ff7988f6e8257e8be0e1284a2f59699054a018f743b1d11',
-              contract_name: 'token', symbol: 'BURGS', active: true, metadata: '', weight: '1.0000000' } ] )
+            { token_id: 1, chain: 0,
+              contract_name: 'token', symbol: 'AZURES', active: true, weight: 1000000000,
+              balance: '9.1464 AZURES', liq_symbol: '4,LIQB',
+              fee_rate: 0, fee_growth: '0', fees: '0.0000 AZURES',
+              limit: { capacity: 0, refill: 0, level: 0, updated: 0 },
+              deposits: '0.0000 AZURES' },
+            { token_id: 2, chain: 0,
+              contract_name: 'token', symbol: 'BURGS', active: true, weight: 1000000000,
+              balance: '10.4562 BURGS', liq_symbol: '4,LIQC',
+              fee_rate: 0, fee_growth: '0', fees: '0.0000 BURGS',
+              limit: { capacity: 0, refill: 0, level: 0, updated: 0 },
+              deposits: '0.0000 BURGS' } ] )
 
         balances = [ token.tables.accounts([nameToBigInt('oswaps')]).getTableRows(),
             oswaps.tables.accounts([nameToBigInt('issuera')]).getTableRows() ]
         assert.deepEqual(balances, [ [ {balance:'10.4562 BURGS'}, {balance:'9.1464 AZURES'}], [{balance:'9.5732 LIQB'}] ])
 
     });
-})
+    it('pages through the pool', async () => {
+        await setupPool()
+        await addThirdToken()
+        const page = async (lower_bound, limit) => {
+          await oswaps.actions.querypage([lower_bound, limit]).send('bob')
+          rvbuf = Buffer.from(blockchain.actionTraces[0].returnValue)
+          return JSON.parse(JSON.stringify(Serializer.decode({data: rvbuf, type: 'poolPage',
+            abi: oswaps.abi})))
+        }
+        rv = await page(0, 2)
+        assert.deepEqual(rv.status_entries.map((e)=>e.token_id), [1, 2])
+        assert.equal(rv.more, 3)
+        rv = await page(rv.more, 2)
+        assert.deepEqual(rv.status_entries.map((e)=>e.token_id), [3])
+        assert.equal(rv.more, 0)
+    });
+    it('ignores donations until reconciled', async () => {
+        await setupPool()
+        console.log('donate BURGS')
+        await token.actions.transfer(['bob', 'oswaps', '500.0000 BURGS', 'gift']).send('bob')
+        await oswaps.actions.querypool([[1,2]]).send('bob')
+        rvbuf = Buffer.from(blockchain.actionTraces[0].returnValue)
+        rv = JSON.parse(JSON.stringify(Serializer.decode({data: rvbuf, type: 'poolStatus', abi: oswaps.abi})))
+        assert.deepEqual(rv.status_entries.map((e)=>e.balance), ['1000.0000 AZURES', '1000.0000 BURGS'])
+        await oswaps.actions.querypool([[]]).send('bob')
+        rvbuf = Buffer.from(blockchain.actionTraces[0].returnValue)
+        assert.deepEqual(JSON.parse(JSON.stringify(Serializer.decode({data: rvbuf, type: 'poolStatus',
+          abi: oswaps.abi}))), rv)
+        console.log('reconcile BURGS')
+        await expectToThrow(
+          oswaps.actions.reconcile(['bob', 2]).send('bob@active'),
+          "eosio_assert: must be manager")
+        await oswaps.actions.reconcile(['manager', 2]).send('manager@active')
+        await oswaps.actions.querypool([[1,2]]).send('bob')
+        rvbuf = Buffer.from(blockchain.actionTraces[0].returnValue)
+        rv = JSON.parse(JSON.stringify(Serializer.decode({data: rvbuf, type: 'poolStatus', abi: oswaps.abi})))
+        assert.deepEqual(rv.status_entries.map((e)=>e.balance), ['1000.0000 AZURES', '1500.0000 BURGS'])
+    });
+    it('quotes swaps as executed', async () => {
+        await setupPool()
+        await oswaps.actions.quote([[
+          { in_token_id: 2, out_token_id: 1, amount: '25.0000 BURGS', exact_in: true },
+          { in_token_id: 2, out_token_id: 1, amount: '25.0000 AZURES', exact_in: false } ]]).send('bob')
+        rvbuf = Buffer.from(blockchain.actionTraces[0].returnValue)
+        rv = JSON.parse(JSON.stringify(Serializer.decode({data: rvbuf, type: 'swapQuotes', abi: oswaps.abi})))
+        const [qin, qout] = rv.quote_entries
+        assert.equal(qin.in_amount, '25.0000 BURGS')
+        assert.equal(qout.out_amount, '25.0000 AZURES')
+        assert.isAbove(qin.price_impact, 0.02)
+        assert.isBelow(qin.spot_price, 1.0)
 
+        console.log('exact in swap matches quote')
+        await blockchain.applyTransaction(Transaction.from({
+          expiration: 0, ref_block_num: 0, ref_block_prefix: 0,
+          actions: [ exprepfromAction(oswaps, 'bob', 'alice', 2, 1, '25.0000 BURGS', ''),
+                     transferAction(token, 'bob', 'oswaps', '25.0000 BURGS', '') ]
+        }))
+        balances = token.tables.accounts([nameToBigInt('alice')]).getTableRows()
+        assert.deepEqual(balances, [ {balance: qin.out_amount} ])
+    });
+    it('accepts asset-typed amounts', async () => {
+        await setupPool()
+        await oswaps.actions.quote([[
+          { in_token_id: 2, out_token_id: 1, amount: '10.0000 BURGS', exact_in: true } ]]).send('bob')
+        rvbuf = Buffer.from(blockchain.actionTraces[0].returnValue)
+        rv = JSON.parse(JSON.stringify(Serializer.decode({data: rvbuf, type: 'swapQuotes', abi: oswaps.abi})))
+        await blockchain.applyTransaction(Transaction.from({
+          expiration: 0, ref_block_num: 0, ref_block_prefix: 0,
+          actions: [ prepAction(oswaps, 'bob', 'exprepfrom2', { sender: 'bob', recipient: 'alice',
+                       in_token_id: 2, out_token_id: 1, in_amount: '10.0000 BURGS', memo: '' }),
+                     transferAction(token, 'bob', 'oswaps', '10.0000 BURGS', '') ]
+        }))
+        balances = token.tables.accounts([nameToBigInt('alice')]).getTableRows()
+        assert.deepEqual(balances, [ {balance: rv.quote_entries[0].out_amount} ])
+        await expectToThrow(blockchain.applyTransaction(Transaction.from({
+          expiration: 0, ref_block_num: 0, ref_block_prefix: 0,
+          actions: [ prepAction(oswaps, 'bob', 'exprepto2', { sender: 'bob', recipient: 'alice',
+                       in_token_id: 2, out_token_id: 1, out_amount: '1.0000 BURGS', memo: '' }),
+                     transferAction(token, 'bob', 'oswaps', '10.0000 BURGS', '') ]
+        })), "eosio_assert: mismatched symbol")
+        await oswaps.actions.withdraw2(['issuera', 1, '5.0000 AZURES', 0.00]).send('manager')
+        balances = token.tables.accounts([nameToBigInt('issuera')]).getTableRows()
+        assert.deepEqual(balances, [ {balance: '999005.0000 AZURES'} ])
+    });
+    it('bounds prep exchanges by min_out, max_in and a deadline', async () => {
+        await setupPool()
+        const prepped = (type, params, qty) => blockchain.applyTransaction(Transaction.from({
+          expiration: 0, ref_block_num: 0, ref_block_prefix: 0,
+          actions: [ prepAction(oswaps, 'bob', type, { sender: 'bob', recipient: 'alice',
+                       in_token_id: 2, out_token_id: 1, memo: '', ...params }),
+                     transferAction(token, 'bob', 'oswaps', qty, '') ]
+        }))
+        await expectToThrow(prepped('exprepfrom2', { in_amount: '10.0000 BURGS',
+          min_out: '10.0000 AZURES' }, '10.0000 BURGS'), "eosio_assert: swap output is less than min_out")
+        await expectToThrow(prepped('exprepto2', { out_amount: '10.0000 AZURES',
+          max_in: '10.0000 BURGS' }, '20.0000 BURGS'), "eosio_assert: swap input is more than max_in")
+        await expectToThrow(prepped('exprepfrom2', { in_amount: '10.0000 BURGS',
+          min_out: '9.0000 AZURES', expires: '1970-01-01T00:00:01' }, '10.0000 BURGS'),
+          "eosio_assert: swap expired")
+        await prepped('exprepfrom2', { in_amount: '10.0000 BURGS', min_out: '9.0000 AZURES',
+          expires: '2100-01-01T00:00:00' }, '10.0000 BURGS')
+        balances = token.tables.accounts([nameToBigInt('alice')]).getTableRows()
+        assert.isAbove(parseFloat(balances[0].balance), 9)
+    });
+    it('pays swap fees to liquidity providers', async () => {
+        await setupPool()
+        await oswaps.actions.setfee(['manager', 2, 'BURGS', 0.01]).send('manager@active')
+        await token.actions.transfer(['bob', 'oswaps', '100.0000 BURGS', '#F,1,alice,0']).send('bob@active')
+        await oswaps.actions.queryfees(['issuerb', [2]]).send('bob')
+        rvbuf = Buffer.from(blockchain.actionTraces[0].returnValue)
+        rv = JSON.parse(JSON.stringify(Serializer.decode({data: rvbuf, type: 'accountFees', abi: oswaps.abi})))
+        assert.deepEqual(rv.fee_entries, [ { token_id: 2, fees: '0.9999 BURGS' } ])
+        await oswaps.actions.claimfees(['issuerb', 2]).send('issuerb@active')
+        balances = token.tables.accounts([nameToBigInt('issuerb')]).getTableRows()
+        assert.deepEqual(balances, [ {balance: '998000.9999 BURGS'} ])
+        rows = oswaps.tables.tokensa(nameToBigInt('oswaps')).getTableRows()
+        assert.equal(rows[1].balance, '1099.0000 BURGS')
+        assert.equal(rows[1].fees, '0.0001 BURGS')
+        await expectToThrow(oswaps.actions.claimfees(['issuerb', 2]).send('issuerb@active'),
+          "eosio_assert: no fees to claim")
+    });
+    it('rate limits liquidity changes and exchange outputs', async () => {
+        await setupPool()
+        await oswaps.actions.setlimit(['manager', 1, '10.0000 AZURES', '0.0001 AZURES']).send('manager@active')
+        await oswaps.actions.withdraw2(['issuera', 1, '6.0000 AZURES', 0.00]).send('manager')
+        await expectToThrow(oswaps.actions.withdraw2(['issuera', 1, '6.0000 AZURES', 0.00]).send('manager'),
+          "eosio_assert: AZURES rate limit exceeded, retry later")
+        await expectToThrow(
+          token.actions.transfer(['bob', 'oswaps', '10.0000 BURGS', '#T,1,,60000']).send('bob@active'),
+          "eosio_assert: AZURES rate limit exceeded, retry later")
+        await token.actions.transfer(['bob', 'oswaps', '10.0000 BURGS', '#T,1,,30000']).send('bob@active')
+    });
+    it('rejects a second asset for the same token', async () => {
+        await setupPool()
+        await expectToThrow(oswaps.actions.createasseta(['bob', 'Telos', 'token', 'BURGS', ''])
+          .send('bob@active'), "eosio_assert: asset already registered")
+    });
+    it('reclaims LIQ balances of forgotten assets', async () => {
+        await setupPool()
+        await oswaps.actions.forgetasset(['manager', 1, '']).send('manager@active')
+        await oswaps.actions.gc(['issuera', 10]).send('bob@active')
+        assert.deepEqual(oswaps.tables.accounts([nameToBigInt('issuera')]).getTableRows(), [])
+        await oswaps.actions.gc(['issuerb', 10]).send('bob@active')
+        assert.deepEqual(oswaps.tables.accounts([nameToBigInt('issuerb')]).getTableRows(),
+          [ {balance: '1000.0000 LIQC'} ])
+    });
+    it('resets in bounded steps', async () => {
+        await setupPool()
+        await oswaps.actions.reset([1]).send('oswaps@owner')
+        await expectToThrow(oswaps.actions.init(['manager', 'Telos']).send('oswaps@owner'),
+          "eosio_assert: reset in progress")
+        await oswaps.actions.reset([100]).send('oswaps@owner')
+        assert.deepEqual(oswaps.tables.tokensa(nameToBigInt('oswaps')).getTableRows(), [])
+        assert.deepEqual(oswaps.tables.stat(symbolCodeToBigInt(symLIQB)).getTableRows(), [])
+        // the last token id waits for the next init
+        rows = oswaps.tables.cleanups(nameToBigInt('oswaps')).getTableRows()
+        assert.equal(rows.length, 1)
+        assert.equal(Number(rows[0].last_token_id), 2)
+        await oswaps.actions.init(['manager', 'Telos']).send('oswaps@owner')
+        assert.deepEqual(oswaps.tables.cleanups(nameToBigInt('oswaps')).getTableRows(), [])
+        assert.equal(Number(oswaps.tables.configs(nameToBigInt('oswaps')).getTableRows()[0].last_token_id), 2)
+    });
+    it('queues withdrawals until cranked', async () => {
+        await setupPool()
+        await oswaps.actions.withdrawq(['issuera', 1, '2.0000 AZURES']).send('manager@active')
+        await oswaps.actions.withdrawq(['issuera', 1, '3.0000 AZURES']).send('manager@active')
+        balances = token.tables.accounts([nameToBigInt('issuera')]).getTableRows()
+        assert.deepEqual(balances, [ {balance: '999000.0000 AZURES'} ])
+        await oswaps.actions.crank([10]).send('bob@active')
+        balances = [ token.tables.accounts([nameToBigInt('issuera')]).getTableRows(),
+            oswaps.tables.accounts([nameToBigInt('issuera')]).getTableRows() ]
+        assert.deepEqual(balances, [ [ {balance: '999005.0000 AZURES'} ], [ {balance: '995.0000 LIQB'} ] ])
+        rows = oswaps.tables.stat(symbolCodeToBigInt(symLIQB)).getTableRows()
+        assert.equal(rows[0].supply, '995.0000 LIQB')
+        assert.deepEqual(oswaps.tables.withdrawals(nameToBigInt('oswaps')).getTableRows(), [])
+        await expectToThrow(oswaps.actions.crank([10]).send('bob@active'),
+          "eosio_assert: no queued withdrawals")
+    });
+    it('settles batch swaps at a uniform price', async () => {
+        await setupPool()
+        await oswaps.actions.setbatch(['manager', 60]).send('manager@active')
+        await token.actions.transfer(['issuera', 'oswaps', '10.0000 AZURES', '#B,2,alice,0']).send('issuera@active')
+        await token.actions.transfer(['bob', 'oswaps', '5.0000 BURGS', '#B,1,,0']).send('bob@active')
+        await token.actions.transfer(['bob', 'oswaps', '1.0000 BURGS', '#B,1,,20000']).send('bob@active')
+        await expectToThrow(oswaps.actions.settle([10]).send('alice@active'),
+          "eosio_assert: no intents to settle")
+        // disabling batch swaps makes the open window due
+        await oswaps.actions.setbatch(['manager', 0]).send('manager@active')
+        await oswaps.actions.settle([10]).send('alice@active')
+        balances = [ token.tables.accounts([nameToBigInt('alice')]).getTableRows(),
+             token.tables.accounts([nameToBigInt('bob')]).getTableRows() ]
+        const burgs = parseFloat(balances[0][0].balance)
+        const azures = parseFloat(balances[1].find((e)=>(e.balance.split(' ')[1]=='AZURES')).balance)
+        assert.isBelow(burgs, 10)
+        assert.closeTo((burgs / 10) * (azures / 5), 1.0, 0.0001)
+        // the intent with an unreachable minimum was refunded
+        assert.equal(balances[1].find((e)=>(e.balance.split(' ')[1]=='BURGS')).balance, '995.0000 BURGS')
+        assert.deepEqual(oswaps.tables.intents(nameToBigInt('oswaps')).getTableRows(), [])
+    });
+    it('swaps on a single transfer with a memo', async () => {
+        await setupPool()
+        await oswaps.actions.quote([[
+          { in_token_id: 2, out_token_id: 1, amount: '25.0000 BURGS', exact_in: true } ]]).send('bob')
+        rvbuf = Buffer.from(blockchain.actionTraces[0].returnValue)
+        rv = JSON.parse(JSON.stringify(Serializer.decode({data: rvbuf, type: 'swapQuotes', abi: oswaps.abi})))
+        const out_raw = Math.round(parseFloat(rv.quote_entries[0].out_amount) * 10000)
+        console.log('memo swap with unreachable min_out')
+        await expectToThrow(token.actions.transfer(['bob', 'oswaps', '25.0000 BURGS',
+          `#F,1,alice,${out_raw + 1}`]).send('bob@active'),
+          "eosio_assert: swap output is less than min_out")
+        await expectToThrow(token.actions.transfer(['bob', 'oswaps', '25.0000 BURGS',
+          '#F,1,alice']).send('bob@active'), "eosio_assert: malformed swap memo")
+        console.log('exact in memo swap')
+        await token.actions.transfer(['bob', 'oswaps', '25.0000 BURGS',
+          `#F,1,alice,${out_raw}`]).send('bob@active')
+        balances = token.tables.accounts([nameToBigInt('alice')]).getTableRows()
+        assert.deepEqual(balances, [ {balance: rv.quote_entries[0].out_amount} ])
+        console.log('exact out memo swap refunds the unused input')
+        await token.actions.transfer(['bob', 'oswaps', '50.0000 BURGS', '#T,1,,100000']).send('bob@active')
+        balances = token.tables.accounts([nameToBigInt('bob')]).getTableRows()
+        assert.equal(balances.find((e)=>(e.balance.split(' ')[1]=='AZURES')).balance, '10.0000 AZURES')
+        assert.isAbove(parseFloat(balances.find((e)=>(e.balance.split(' ')[1]=='BURGS')).balance), 1000 - 50)
+    });
+    it('reports time-weighted prices', async () => {
+        await setupPool()
+        const start = Math.floor(blockchain.timestamp.toMilliseconds() / 1000)
+        blockchain.addTime(TimePointSec.from(600))
+        await token.actions.transfer(['bob', 'oswaps', '1000.0000 BURGS', '#F,1,,0']).send('bob@active')
+        blockchain.addTime(TimePointSec.from(600))
+        await oswaps.actions.querytwap([1, 2, start, 0]).send('bob')
+        rvbuf = Buffer.from(blockchain.actionTraces[0].returnValue)
+        rv = JSON.parse(JSON.stringify(Serializer.decode({data: rvbuf, type: 'twapPrice', abi: oswaps.abi})))
+        // 1 BURGS per AZURES, then 4 once the pool holds 2000 BURGS and 500 AZURES
+        assert.closeTo(rv.price, 2.0, 0.001)
+    });
+    it('logs exchanges for indexers', async () => {
+        await setupPool()
+        await token.actions.transfer(['bob', 'oswaps', '25.0000 BURGS', '#F,1,alice,0']).send('bob@active')
+        const trace = blockchain.actionTraces.find((t) => String(t.action.name) == 'logswap')
+        rv = JSON.parse(JSON.stringify(Serializer.decode({data: trace.action.data, type: 'logswap',
+          abi: oswaps.abi})))
+        balances = token.tables.accounts([nameToBigInt('alice')]).getTableRows()
+        assert.include(rv.event, { sender: 'bob', recipient: 'alice', in_token_id: 2, out_token_id: 1,
+          in_amount: 250000, in_bal_before: 10000000, in_bal_after: 10250000,
+          out_bal_before: 10000000 })
+        assert.equal(rv.event.out_amount, Math.round(parseFloat(balances[0].balance) * 10000))
+        assert.equal(rv.event.out_bal_after, 10000000 - rv.event.out_amount)
+    });
+    it('swaps between internal deposits', async () => {
+        await setupPool()
+        await token.actions.transfer(['bob', 'oswaps', '100.0000 BURGS', '#D']).send('bob@active')
+        await expectToThrow(oswaps.actions.swapint(['bob', 2, 1, '50.0000 BURGS', 500000000]).send('bob@active'),
+          "eosio_assert: swap output is less than min_out")
+        await oswaps.actions.swapint(['bob', 2, 1, '50.0000 BURGS', 0]).send('bob@active')
+        rv = oswaps.tables.deposits([nameToBigInt('bob')]).getTableRows()
+        assert.equal(rv.find((e)=>(e.token_id==2)).balance, '50.0000 BURGS')
+        const out = rv.find((e)=>(e.token_id==1)).balance
+        assert.isAbove(parseFloat(out), 45)
+        await expectToThrow(oswaps.actions.depwithdraw(['bob', 2, '50.0001 BURGS']).send('bob@active'),
+          "eosio_assert: insufficient deposit")
+        await oswaps.actions.depwithdraw(['bob', 1, out]).send('bob@active')
+        balances = token.tables.accounts([nameToBigInt('bob')]).getTableRows()
+        assert.equal(balances.find((e)=>(e.balance.split(' ')[1]=='AZURES')).balance, out)
+    });
+    it('settles a batch of operations net', async () => {
+        await setupPool()
+        await token.actions.transfer(['bob', 'oswaps', '100.0000 BURGS', '#D']).send('bob@active')
+        const op = (op, token_id, out_token_id, amount, weight) => (
+          { op, token_id, out_token_id, amount, min_out: 0, weight })
+        await expectToThrow(oswaps.actions.batch(['bob', [ op('addliq', 2, 0, '100.0001 BURGS', 0) ]])
+          .send('bob@active'), "eosio_assert: insufficient deposit")
+        await oswaps.actions.batch(['bob', [ op('addliq', 2, 0, '40.0000 BURGS', 0),
+          op('swap', 2, 1, '50.0000 BURGS', 0), op('swap', 1, 2, '10.0000 AZURES', 0) ]])
+          .send('bob@active')
+        rv = oswaps.tables.deposits([nameToBigInt('bob')]).getTableRows()
+        const spent = 100 - parseFloat(rv[0].balance)
+        assert.isAbove(spent, 75)
+        assert.isBelow(spent, 85)
+        // AZURES came out net, in a single transfer
+        balances = token.tables.accounts([nameToBigInt('bob')]).getTableRows()
+        assert.isAbove(parseFloat(balances.find((e)=>(e.balance.split(' ')[1]=='AZURES')).balance), 30)
+        rv = oswaps.tables.accounts([nameToBigInt('bob')]).getTableRows()
+        assert.deepEqual(rv, [ {balance: '40.0000 LIQC'} ])
+    });
+    it('routes a swap through an intermediate token', async () => {
+        await setupPool()
+        await addThirdToken()
+        console.log('route BURGS -> AZURES -> CASH with unreachable min_out')
+        await expectToThrow(blockchain.applyTransaction(Transaction.from({
+          expiration: 0, ref_block_num: 0, ref_block_prefix: 0,
+          actions: [ exrouteAction(oswaps, 'bob', 'alice', [2, 1, 3], '10.0000 BURGS', '20.00 CASH', ''),
+                     transferAction(token, 'bob', 'oswaps', '10.0000 BURGS', '') ]
+        })), "eosio_assert: route output is less than min_out")
+        console.log('route BURGS -> AZURES -> CASH')
+        await blockchain.applyTransaction(Transaction.from({
+          expiration: 0, ref_block_num: 0, ref_block_prefix: 0,
+          actions: [ exrouteAction(oswaps, 'bob', 'alice', [2, 1, 3], '10.0000 BURGS', '19.00 CASH', ''),
+                     transferAction(token, 'bob', 'oswaps', '10.0000 BURGS', '') ]
+        }))
+        balances = [ token.tables.accounts([nameToBigInt('oswaps')]).getTableRows(),
+             token.tables.accounts([nameToBigInt('alice')]).getTableRows(),
+             token2.tables.accounts([nameToBigInt('alice')]).getTableRows() ]
+        // the intermediate AZURES never left the pool
+        assert.deepEqual(balances.slice(0, 2), [ [ {balance:'1010.0000 BURGS'}, {balance:'1000.0000 AZURES'}], [] ])
+        assert.isAbove(parseFloat(balances[2][0].balance), 19.0)
+    });
+    it('swaps with prepended actions (benchmark)', async () => {
+        await setupPool()
+        const swaps = 20
+        for (const action_count of [2, 10, 50]) {
+          let elapsed = 0
+          for (let i = 0; i < swaps; ++i) {
+            // wallets may prepend unrelated actions; only the final two concern oswaps
+            const prepended = Array.from({length: action_count - 2},
+              () => transferAction(token, 'bob', 'user1', '0.0001 BURGS', ''))
+            const start = process.hrtime.bigint()
+            await blockchain.applyTransaction(Transaction.from({
+              expiration: 0, ref_block_num: 0, ref_block_prefix: 0,
+              actions: [ ...prepended,
+                         exprepfromAction(oswaps, 'bob', 'alice', 2, 1, '0.1000 BURGS', ''),
+                         transferAction(token, 'bob', 'oswaps', '0.1000 BURGS', '') ]
+            }))
+            elapsed += Number(process.hrtime.bigint() - start)
+          }
+          console.log(`${action_count}-action swap: ${(elapsed/swaps/1000).toFixed(0)} us/tx`)
+        }
+        balances = token.tables.accounts([nameToBigInt('oswaps')]).getTableRows()
+        assert.deepEqual(balances[0], {balance:'1006.0000 BURGS'})
+    });
+})
@@ -0,0 +1,55 @@
+#include "contracts.hpp"
+
+#include "oswaps.hpp"
+#include "token.hpp"
+
+void set_token_contract(mock::chain& c, eosio::name account) {
+  c.set_action(account, "create"_n, mock::bind(&eosio::token::create));
+  c.set_action(account, "issue"_n, mock::bind(&eosio::token::issue));
+  c.set_action(account, "retire"_n, mock::bind(&eosio::token::retire));
+  c.set_action(account, "transfer"_n, mock::bind(&eosio::token::transfer));
+  c.set_action(account, "open"_n, mock::bind(&eosio::token::open));
+  c.set_action(account, "close"_n, mock::bind(&eosio::token::close));
+}
+
+void set_oswaps_contract(mock::chain& c, eosio::name account) {
+  c.set_action(account, "reset"_n, mock::bind(&oswaps::reset));
+  c.set_action(account, "resetacct"_n, mock::bind(&oswaps::resetacct));
+  c.set_action(account, "init"_n, mock::bind(&oswaps::init));
+  c.set_action(account, "freeze"_n, mock::bind(&oswaps::freeze));
+  c.set_action(account, "unfreeze"_n, mock::bind(&oswaps::unfreeze));
+  c.set_action(account, "setfee"_n, mock::bind(&oswaps::setfee));
+  c.set_action(account, "setlimit"_n, mock::bind(&oswaps::setlimit));
+  c.set_action(account, "querypool"_n, mock::bind(&oswaps::querypool));
+  c.set_action(account, "querypage"_n, mock::bind(&oswaps::querypage));
+  c.set_action(account, "quote"_n, mock::bind(&oswaps::quote));
+  c.set_action(account, "queryfees"_n, mock::bind(&oswaps::queryfees));
+  c.set_action(account, "querytwap"_n, mock::bind(&oswaps::querytwap));
+  c.set_action(account, "createasseta"_n, mock::bind(&oswaps::createasseta));
+  c.set_action(account, "forgetasset"_n, mock::bind(&oswaps::forgetasset));
+  c.set_action(account, "gc"_n, mock::bind(&oswaps::gc));
+  c.set_action(account, "logswap"_n, mock::bind(&oswaps::logswap));
+  c.set_action(account, "logliq"_n, mock::bind(&oswaps::logliq));
+  c.set_action(account, "migrate"_n, mock::bind(&oswaps::migrate));
+  c.set_action(account, "reconcile"_n, mock::bind(&oswaps::reconcile));
+  c.set_action(account, "withdraw"_n, mock::bind(&oswaps::withdraw));
+  c.set_action(account, "withdraw2"_n, mock::bind(&oswaps::withdraw2));
+  c.set_action(account, "claimfees"_n, mock::bind(&oswaps::claimfees));
+  c.set_action(account, "swapint"_n, mock::bind(&oswaps::swapint));
+  c.set_action(account, "depwithdraw"_n, mock::bind(&oswaps::depwithdraw));
+  c.set_action(account, "batch"_n, mock::bind(&oswaps::batch));
+  c.set_action(account, "withdrawq"_n, mock::bind(&oswaps::withdrawq));
+  c.set_action(account, "crank"_n, mock::bind(&oswaps::crank));
+  c.set_action(account, "setbatch"_n, mock::bind(&oswaps::setbatch));
+  c.set_action(account, "settle"_n, mock::bind(&oswaps::settle));
+  c.set_action(account, "addliqprep"_n, mock::bind(&oswaps::addliqprep));
+  c.set_action(account, "addliqprep2"_n, mock::bind(&oswaps::addliqprep2));
+  c.set_action(account, "exprepfrom"_n, mock::bind(&oswaps::exprepfrom));
+  c.set_action(account, "exprepfrom2"_n, mock::bind(&oswaps::exprepfrom2));
+  c.set_action(account, "exprepto"_n, mock::bind(&oswaps::exprepto));
+  c.set_action(account, "exprepto2"_n, mock::bind(&oswaps::exprepto2));
+  c.set_action(account, "exroute"_n, mock::bind(&oswaps::exroute));
+  c.set_action(account, "transfer"_n, mock::bind(&oswaps::transfer));
+  c.set_action(account, "retire"_n, mock::bind(&oswaps::retire));
+  c.set_notify(account, "transfer"_n, mock::bind(&oswaps::ontransfer));
+}
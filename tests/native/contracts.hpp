@@ -0,0 +1,7 @@
+#pragma once
+
+#include "mock/chain.hpp"
+
+// registers the actions of each contract, as its ABI would, on `account`
+void set_token_contract(mock::chain& c, eosio::name account);
+void set_oswaps_contract(mock::chain& c, eosio::name account);
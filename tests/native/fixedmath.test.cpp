@@ -0,0 +1,186 @@
+// Native accuracy and benchmark suite for include/fixedmath.hpp
+//
+//   npm run test:native
+//
+// Compares the fixed-point balancer math with an 80-bit long double reference and
+// with the double log/exp computation previously used by `ontransfer`.
+
+#define OSWAPS_MATH_COUNT_OPS
+#include "fixedmath.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace oswaps_math;
+
+static int failures = 0;
+
+#define EXPECT(cond, ...) do { if (!(cond)) { ++failures; \
+  printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static long double to_ld(uint128 x) {
+  return std::ldexp((long double)(uint64_t(x >> 64)), 0) + std::ldexp((long double)uint64_t(x), -64);
+}
+
+static uint128 from_ld(long double x) {
+  long double hi = std::floor(x);
+  return (uint128(uint64_t(hi)) << 64) | uint64_t(std::ldexp(x - hi, 64));
+}
+
+// the computation `ontransfer` used before the fixed-point engine
+static int64_t double_out_bal_after_in(int64_t in_bal, double w_in, int64_t out_bal, double w_out,
+                                       int64_t in_amount) {
+  double lc = log((double)(in_bal + in_amount)/in_bal);
+  double lnc = -(w_in/w_out * lc);
+  return llround(out_bal * exp(lnc));
+}
+
+static int64_t double_in_bal_after_out(int64_t in_bal, double w_in, int64_t out_bal, double w_out,
+                                       int64_t out_amount) {
+  double lc = log((double)(out_bal - out_amount)/out_bal);
+  double lnc = -(w_out/w_in * lc);
+  return llround(in_bal * exp(lnc));
+}
+
+static void test_log() {
+  std::mt19937_64 rng(1);
+  long double max_err = 0;
+  for (int i = 0; i < 100000; ++i) {
+    int bits = 1 + rng() % 62;
+    uint128 x = one + ((uint128(rng()) << 64 | rng()) >> (128 - 64 - bits));
+    long double err = std::fabs(to_ld(oswaps_math::log2(x)) - log2l(to_ld(x)));
+    max_err = std::max(max_err, err);
+  }
+  printf("log2     max abs error %.3Le (2^%.1Lf)\n", max_err, log2l(max_err));
+  EXPECT(max_err < std::ldexp(1.0L, -57), "log2 error too large");
+  EXPECT(oswaps_math::log2(one) == 0, "log2(1) != 0");
+  EXPECT(oswaps_math::log2(one << 10) == (uint128(10) << 64), "log2(1024) != 10");
+  long double ln_err = std::fabs(to_ld(oswaps_math::ln(from_ld(10.0L))) - logl(10.0L));
+  EXPECT(ln_err < std::ldexp(1.0L, -57), "ln(10) error %Le", ln_err);
+}
+
+static void test_exp() {
+  std::mt19937_64 rng(2);
+  long double max_frac = 0, max_exp = 0, max_neg = 0;
+  for (int i = 0; i < 100000; ++i) {
+    uint64_t f = rng();
+    long double ref = exp2l(std::ldexp((long double)f, -64));
+    max_frac = std::max(max_frac, std::fabs(to_ld(exp2_frac(f)) / ref - 1));
+    long double x = std::ldexp((long double)(rng() >> 11), -53) * 43;
+    long double e = to_ld(oswaps_math::exp(from_ld(x)));
+    max_exp = std::max(max_exp, std::fabs(e / expl(x) - 1));
+    long double en = to_ld(oswaps_math::exp_neg(from_ld(x)));
+    max_neg = std::max(max_neg, std::fabs(en - expl(-x)));
+  }
+  printf("exp2frac max rel error %.3Le\n", max_frac);
+  printf("exp      max rel error %.3Le\n", max_exp);
+  printf("exp_neg  max abs error %.3Le\n", max_neg);
+  EXPECT(max_frac < std::ldexp(1.0L, -60), "exp2_frac error too large");
+  EXPECT(max_exp < std::ldexp(1.0L, -56), "exp error too large");
+  EXPECT(max_neg < std::ldexp(1.0L, -60), "exp_neg error too large");
+  EXPECT(oswaps_math::exp(0) == one && oswaps_math::exp_neg(0) == one, "e^0 != 1");
+  EXPECT(oswaps_math::exp(uint128(50) << 64) == max_value, "exp does not saturate");
+  EXPECT(oswaps_math::exp_neg(uint128(100) << 64) == 0, "exp_neg does not underflow to 0");
+}
+
+static void test_pow() {
+  std::mt19937_64 rng(3);
+  long double max_err = 0;
+  for (int i = 0; i < 100000; ++i) {
+    uint64_t num = 1 + rng() % (uint64_t(1) << 40);
+    uint64_t den = 1 + rng() % (uint64_t(1) << 40);
+    uint64_t w_num = 1 + rng() % 1000000000000ull;
+    uint64_t w_den = 1 + rng() % 1000000000000ull;
+    long double e = (long double)w_num / w_den;
+    long double ref = powl((long double)num / den, e);
+    if (ref > std::ldexp(1.0L, 62)) {
+      continue;
+    }
+    // error relative to the documented bound 2^-56 * (1 + e) * result + 2^-60
+    long double bound = std::ldexp(1.0L, -56) * (1 + e) * ref + std::ldexp(1.0L, -60);
+    long double err = std::fabs(to_ld(pow_ratio(num, den, w_num, w_den)) - ref);
+    max_err = std::max(max_err, err / bound);
+  }
+  printf("pow      max error / bound %.3Lf\n", max_err);
+  EXPECT(max_err < 1, "pow_ratio error too large");
+}
+
+static void test_balancer() {
+  // the cases in tests/contract.spec.ts
+  EXPECT(in_bal_after_out(100000, 1000000000, 50000, 500000000, 2000) - 100000 == 2062,
+         "exact out case");
+  EXPECT(48000 - out_bal_after_in(102062, 1000000000, 48000, 500000000, 2500) == 2268,
+         "exact in case");
+
+  std::mt19937_64 rng(4);
+  int64_t max_fixed = 0, max_double = 0;
+  for (int i = 0; i < 100000; ++i) {
+    int64_t in_bal = 1 + rng() % 10000000000000ll;
+    int64_t out_bal = 1 + rng() % 10000000000000ll;
+    uint64_t w_in = 1 + rng() % 10000000000ull;
+    uint64_t w_out = 1 + rng() % 10000000000ull;
+    int64_t amount = 1 + rng() % in_bal;
+    long double ref = out_bal * powl((long double)in_bal / (in_bal + amount),
+                                     (long double)w_in / w_out);
+    int64_t ref_bal = llroundl(ref);
+    int64_t fixed = out_bal_after_in(in_bal, w_in, out_bal, w_out, amount);
+    int64_t dbl = double_out_bal_after_in(in_bal, double(w_in), out_bal, double(w_out), amount);
+    max_fixed = std::max(max_fixed, std::abs(fixed - ref_bal));
+    max_double = std::max(max_double, std::abs(dbl - ref_bal));
+
+    int64_t out_amount = rng() % out_bal;
+    ref = in_bal * powl((long double)out_bal / (out_bal - out_amount), (long double)w_out / w_in);
+    if (ref < 4e18) {
+      ref_bal = llroundl(ref);
+      fixed = in_bal_after_out(in_bal, w_in, out_bal, w_out, out_amount);
+      dbl = double_in_bal_after_out(in_bal, double(w_in), out_bal, double(w_out), out_amount);
+      if (ref_bal < (int64_t(1) << 50)) { // where a double still resolves one unit
+        max_fixed = std::max(max_fixed, std::abs(fixed - ref_bal));
+        max_double = std::max(max_double, std::abs(dbl - ref_bal));
+      }
+    }
+  }
+  printf("balancer max error vs reference, token units: fixed %lld, double %lld\n",
+         (long long)max_fixed, (long long)max_double);
+  EXPECT(max_fixed <= 1, "balancer error exceeds one token unit");
+  EXPECT(in_bal_after_out(1000, 1, 1000000, 1000000, 999999) == -1, "overflow not reported");
+}
+
+static void benchmark() {
+  const int n = 200000;
+  std::mt19937_64 rng(5);
+  std::vector<int64_t> in_bal(n), out_bal(n), amount(n);
+  for (int i = 0; i < n; ++i) {
+    in_bal[i] = 1000000 + rng() % 1000000000;
+    out_bal[i] = 1000000 + rng() % 1000000000;
+    amount[i] = 1 + rng() % 1000000;
+  }
+  volatile int64_t sink = 0;
+  mul_count = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i) {
+    sink = sink + out_bal_after_in(in_bal[i], 1000000000, out_bal[i], 700000000, amount[i]);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i) {
+    sink = sink + double_out_bal_after_in(in_bal[i], 1.0, out_bal[i], 0.7, amount[i]);
+  }
+  auto t2 = std::chrono::steady_clock::now();
+  auto ns = [&](auto a, auto b) {
+    return std::chrono::duration<double, std::nano>(b - a).count() / n;
+  };
+  printf("swap math: fixed %.1f ns, %.1f 64x64 multiplies; double %.1f ns, 1 log + 1 exp\n",
+         ns(t0, t1), double(mul_count) / n, ns(t1, t2));
+}
+
+int main() {
+  test_log();
+  test_exp();
+  test_pow();
+  test_balancer();
+  benchmark();
+  printf(failures ? "%d FAILED\n" : "all passed\n", failures);
+  return failures ? 1 : 0;
+}
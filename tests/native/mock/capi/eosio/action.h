@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void require_auth2(uint64_t name, uint64_t permission);
+
+#ifdef __cplusplus
+}
+#endif
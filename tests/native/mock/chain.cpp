@@ -0,0 +1,294 @@
+#include "chain.hpp"
+
+#include <capi/eosio/action.h>
+
+#include <algorithm>
+
+namespace mock {
+
+using eosio::check;
+
+static chain* active = nullptr;
+
+struct chain::context {
+  const eosio::action&     act;
+  eosio::name              receiver;
+  std::vector<eosio::name> notified;
+  std::vector<eosio::action> inlines;
+};
+
+struct intrinsics {
+  static chain& c() {
+    check(active != nullptr, "no mock chain");
+    return *active;
+  }
+  static chain::context& ctx() {
+    check(!c().stack.empty(), "no action is executing");
+    return *c().stack.back();
+  }
+  static std::map<table_id, db_table>& tables() { return c().tables; }
+  static std::map<std::pair<table_id, size_t>, secondary_set>& secondaries() {
+    return c().secondaries;
+  }
+  static void set_row(const table_id& t, uint64_t pk, const db_row* old, const db_row* row) {
+    c().undo.push_back({t, pk, old != nullptr, old ? *old : db_row()});
+    c().write_row(t, pk, row);
+  }
+  static std::vector<char>& return_value() { return c().return_value; }
+  static std::set<uint64_t>& accounts() { return c().accounts; }
+  static int64_t now_us() { return c().now_us; }
+  static const std::vector<char>& packed_trx() { return c().packed_trx; }
+};
+
+// nodeos' billable overheads of a key_value_object and of a secondary index object
+static constexpr int64_t row_overhead = 112;
+static constexpr int64_t secondary_overhead = 112;
+
+chain::chain() : now_us(int64_t(1704067200) * 1000000) {
+  check(active == nullptr, "only one mock chain may exist at a time");
+  active = this;
+}
+
+chain::~chain() {
+  active = nullptr;
+}
+
+void chain::create_account(eosio::name account) {
+  accounts.insert(account.value);
+}
+
+void chain::set_action(eosio::name account, eosio::name action, handler h) {
+  accounts.insert(account.value);
+  actions[{account.value, action.value}] = std::move(h);
+}
+
+void chain::set_notify(eosio::name account, eosio::name action, handler h) {
+  accounts.insert(account.value);
+  notify[{account.value, action.value}] = std::move(h);
+}
+
+void chain::advance(int64_t seconds) {
+  now_us += seconds * 1000000;
+}
+
+int64_t chain::ram_usage(eosio::name payer) const {
+  int64_t bytes = 0;
+  for (const auto& t : tables) {
+    for (const auto& r : t.second) {
+      if (r.second.payer == payer.value) {
+        bytes += int64_t(r.second.data.size()) + row_overhead
+          + secondary_overhead * int64_t(r.second.secondary.size());
+      }
+    }
+  }
+  return bytes;
+}
+
+push_result chain::push_transaction(const std::vector<eosio::action>& acts) {
+  push_result result;
+  eosio::transaction trx;
+  trx.expiration = eosio::time_point_sec(uint32_t(now_us / 1000000) + 60);
+  trx.actions = acts;
+  packed_trx = eosio::pack(trx);
+  result.net_bytes = packed_trx.size();
+  return_value.clear();
+  undo.clear();
+  try {
+    for (const auto& a : acts) {
+      check(accounts.count(a.account.value), "unknown account " + a.account.to_string());
+      execute(a, a.account, 0);
+    }
+  } catch (const assertion& e) {
+    result.error = std::string("eosio_assert: ") + e.what();
+  } catch (const std::exception& e) {
+    result.error = e.what();
+  }
+  if (!result.error.empty()) {
+    stack.clear();
+    rollback();
+  }
+  undo.clear();
+  result.return_value = std::move(return_value);
+  return result;
+}
+
+void chain::execute(const eosio::action& act, eosio::name receiver, int depth) {
+  check(depth < 8, "max inline action depth exceeded");
+  context ctx{act, receiver, {}, {}};
+  handler* h = nullptr;
+  if (receiver == act.account) {
+    auto it = actions.find({receiver.value, act.name.value});
+    if (it != actions.end()) {
+      h = &it->second;
+    } else {
+      check(!std::any_of(actions.begin(), actions.end(),
+                         [&](const auto& e) { return e.first.first == receiver.value; }),
+        "unknown action " + act.name.to_string() + " in contract " + receiver.to_string());
+    }
+  } else {
+    auto it = notify.find({receiver.value, act.name.value});
+    if (it != notify.end()) {
+      h = &it->second;
+    }
+  }
+  if (h) {
+    stack.push_back(&ctx);
+    (*h)(receiver, act.account, act.data);
+    stack.pop_back();
+  }
+  for (size_t i = 0; i < ctx.notified.size(); ++i) {
+    execute(act, ctx.notified[i], depth);
+  }
+  for (const auto& a : ctx.inlines) {
+    check(accounts.count(a.account.value), "unknown account " + a.account.to_string());
+    execute(a, a.account, depth + 1);
+  }
+}
+
+void chain::write_row(const table_id& t, uint64_t pk, const db_row* row) {
+  db_table& tbl = tables[t];
+  auto old = tbl.find(pk);
+  if (old != tbl.end()) {
+    for (size_t i = 0; i < old->second.secondary.size(); ++i) {
+      secondaries[{t, i}].erase({old->second.secondary[i], pk});
+    }
+    tbl.erase(old);
+  }
+  if (row) {
+    for (size_t i = 0; i < row->secondary.size(); ++i) {
+      secondaries[{t, i}].insert({row->secondary[i], pk});
+    }
+    tbl[pk] = *row;
+  }
+}
+
+void chain::rollback() {
+  for (auto it = undo.rbegin(); it != undo.rend(); ++it) {
+    write_row(it->table, it->pk, it->existed ? &it->before : nullptr);
+  }
+}
+
+void set_return_value(std::vector<char> value) {
+  intrinsics::return_value() = std::move(value);
+}
+
+void send_inline(const eosio::action& a) {
+  intrinsics::ctx().inlines.push_back(a);
+}
+
+const db_table* db_find_table(const table_id& t) {
+  auto& tables = intrinsics::tables();
+  auto it = tables.find(t);
+  return it == tables.end() ? nullptr : &it->second;
+}
+
+const db_row* db_get(const table_id& t, uint64_t pk) {
+  const db_table* tbl = db_find_table(t);
+  if (!tbl) {
+    return nullptr;
+  }
+  auto it = tbl->find(pk);
+  return it == tbl->end() ? nullptr : &it->second;
+}
+
+const secondary_set* db_secondary(const table_id& t, size_t index) {
+  auto& s = intrinsics::secondaries();
+  auto it = s.find({t, index});
+  return it == s.end() ? nullptr : &it->second;
+}
+
+void db_set(const table_id& t, uint64_t pk, db_row row) {
+  check(t.code == intrinsics::ctx().receiver.value, "db access violation");
+  const db_row* old = db_get(t, pk);
+  if (row.payer == 0) {
+    check(old != nullptr, "must specify a valid account to pay for new record");
+    row.payer = old->payer;
+  }
+  intrinsics::set_row(t, pk, old, &row);
+}
+
+void db_remove(const table_id& t, uint64_t pk) {
+  check(t.code == intrinsics::ctx().receiver.value, "db access violation");
+  const db_row* old = db_get(t, pk);
+  check(old != nullptr, "cannot remove a row which does not exist");
+  intrinsics::set_row(t, pk, old, nullptr);
+}
+
+} // namespace mock
+
+namespace eosio {
+
+using mock::intrinsics;
+
+void require_auth(name n) {
+  for (const auto& p : intrinsics::ctx().act.authorization) {
+    if (p.actor == n) {
+      return;
+    }
+  }
+  check(false, "missing authority of " + n.to_string());
+}
+
+void require_auth(const permission_level& level) {
+  for (const auto& p : intrinsics::ctx().act.authorization) {
+    if (p == level) {
+      return;
+    }
+  }
+  check(false, "missing authority of " + level.actor.to_string() + "@"
+    + level.permission.to_string());
+}
+
+bool has_auth(name n) {
+  for (const auto& p : intrinsics::ctx().act.authorization) {
+    if (p.actor == n) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool is_account(name n) {
+  return intrinsics::accounts().count(n.value) > 0;
+}
+
+void require_recipient(name notify_account) {
+  auto& ctx = intrinsics::ctx();
+  if (notify_account == ctx.receiver) {
+    return;
+  }
+  for (name n : ctx.notified) {
+    if (n == notify_account) {
+      return;
+    }
+  }
+  ctx.notified.push_back(notify_account);
+}
+
+time_point current_time_point() {
+  return time_point(microseconds(intrinsics::now_us()));
+}
+
+} // namespace eosio
+
+extern "C" {
+
+void require_auth2(uint64_t name, uint64_t permission) {
+  eosio::require_auth(eosio::permission_level(eosio::name(name), eosio::name(permission)));
+}
+
+size_t read_transaction(char* buffer, size_t size) {
+  const auto& trx = mock::intrinsics::packed_trx();
+  if (size == 0) {
+    return trx.size();
+  }
+  size_t n = size < trx.size() ? size : trx.size();
+  memcpy(buffer, trx.data(), n);
+  return n;
+}
+
+size_t transaction_size() {
+  return mock::intrinsics::packed_trx().size();
+}
+
+}
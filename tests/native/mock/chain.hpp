@@ -0,0 +1,117 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/transaction.hpp>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+   /**
+    * In-memory chain for running contracts natively. Actions execute as on
+    *   nodeos: each action's notifications run after it, followed by the inline
+    *   actions it sent; a failed `check` rolls the whole transaction back.
+    *
+    * Contracts are registered per account with `set_action` / `set_notify`,
+    *   using `bind` to unpack the action data into a contract member function.
+    */
+
+namespace mock {
+
+using handler = std::function<void(eosio::name receiver, eosio::name code,
+                                   const std::vector<char>& data)>;
+
+// stores the packed return value of a read-only action
+void set_return_value(std::vector<char> value);
+
+template<typename C, typename R, typename... Args>
+handler bind(R (C::*f)(Args...)) {
+  return [f](eosio::name receiver, eosio::name code, const std::vector<char>& data) {
+    auto args = eosio::unpack<std::tuple<std::decay_t<Args>...>>(data);
+    eosio::datastream<const char*> ds(data.data(), data.size());
+    // on the heap: GCC cannot tell that a call through `f` reads nothing outside a stack
+    //   object, and warns that it may be uninitialized
+    auto c = std::make_unique<C>(receiver, code, ds);
+    if constexpr (std::is_void_v<R>) {
+      std::apply([&](auto&... a) { (c.get()->*f)(a...); }, args);
+    } else {
+      set_return_value(eosio::pack(std::apply([&](auto&... a) { return (c.get()->*f)(a...); }, args)));
+    }
+  };
+}
+
+struct push_result {
+  std::string       error;        // empty on success; "eosio_assert: ..." for a failed check
+  size_t            net_bytes = 0; // size of the packed transaction
+  std::vector<char> return_value; // of the last action which returned one
+
+  explicit operator bool() const { return error.empty(); }
+};
+
+class chain {
+  public:
+    chain();
+    ~chain();
+
+    void create_account(eosio::name account);
+    void set_action(eosio::name account, eosio::name action, handler h);
+    // notification handler for `action` sent by any contract (on_notify("*::action"))
+    void set_notify(eosio::name account, eosio::name action, handler h);
+
+    push_result push_transaction(const std::vector<eosio::action>& actions);
+
+    template<typename... Args>
+    push_result push_action(eosio::name account, eosio::name action,
+                            eosio::permission_level auth, Args&&... args) {
+      return push_transaction({ eosio::action(auth, account, action,
+                                  std::make_tuple(std::forward<Args>(args)...)) });
+    }
+
+    void advance(int64_t seconds);
+
+    // bytes billed to `payer`: packed rows plus nodeos' per-row overheads
+    int64_t ram_usage(eosio::name payer) const;
+
+    // all rows of a table, unpacked as T
+    template<typename T>
+    std::vector<T> rows(eosio::name code, uint64_t scope, eosio::name table) const {
+      std::vector<T> r;
+      const db_table* t = db_find_table({code.value, scope, table.value});
+      if (t) {
+        for (const auto& e : *t) {
+          r.push_back(eosio::unpack<T>(e.second.data));
+        }
+      }
+      return r;
+    }
+
+  private:
+    friend struct intrinsics;
+    struct context;
+    struct undo_entry {
+      table_id              table;
+      uint64_t              pk;
+      bool                  existed;
+      db_row                before;
+    };
+
+    void execute(const eosio::action& act, eosio::name receiver, int depth);
+    void rollback();
+    void write_row(const table_id& t, uint64_t pk, const db_row* row);
+
+    std::set<uint64_t>                                   accounts;
+    std::map<std::pair<uint64_t, uint64_t>, handler>     actions;
+    std::map<std::pair<uint64_t, uint64_t>, handler>     notify;
+    std::map<table_id, db_table>                         tables;
+    std::map<std::pair<table_id, size_t>, secondary_set> secondaries;
+    std::vector<undo_entry>                              undo;
+    std::vector<context*>                                stack;
+    std::vector<char>                                    packed_trx;
+    std::vector<char>                                    return_value;
+    int64_t                                              now_us;
+};
+
+} // namespace mock
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "datastream.hpp"
+#include "name.hpp"
+
+#include <vector>
+
+namespace eosio {
+
+struct permission_level {
+  permission_level(name a = name(), name p = name()) : actor(a), permission(p) {}
+
+  name actor;
+  name permission;
+
+  friend bool operator==(const permission_level& a, const permission_level& b) {
+    return a.actor == b.actor && a.permission == b.permission;
+  }
+
+  EOSLIB_SERIALIZE(permission_level, (actor)(permission))
+};
+
+struct action;
+
+} // namespace eosio
+
+namespace mock {
+
+// implemented by the mock chain
+void send_inline(const eosio::action& a);
+
+} // namespace mock
+
+namespace eosio {
+
+struct action {
+  eosio::name account;
+  eosio::name name;
+  std::vector<permission_level> authorization;
+  std::vector<char> data;
+
+  action() = default;
+
+  template<typename T>
+  action(const permission_level& auth, eosio::name a, eosio::name n, T&& value)
+    : account(a), name(n), authorization{auth}, data(pack(std::forward<T>(value))) {}
+
+  template<typename T>
+  action(std::vector<permission_level> auths, eosio::name a, eosio::name n, T&& value)
+    : account(a), name(n), authorization(std::move(auths)), data(pack(std::forward<T>(value))) {}
+
+  void send() const { mock::send_inline(*this); }
+
+  template<typename T>
+  T data_as() const { return unpack<T>(data); }
+
+  EOSLIB_SERIALIZE(action, (account)(name)(authorization)(data))
+};
+
+void require_auth(name n);
+void require_auth(const permission_level& level);
+bool has_auth(name n);
+bool is_account(name n);
+void require_recipient(name notify_account);
+
+template<typename... Names>
+void require_recipient(name notify_account, Names... remaining) {
+  require_recipient(notify_account);
+  require_recipient(remaining...);
+}
+
+template<name::raw Name, auto Action>
+struct action_wrapper {
+  template<typename Code>
+  action_wrapper(Code&& code, std::vector<permission_level>&& perms)
+    : code_name(std::forward<Code>(code)), permissions(std::move(perms)) {}
+  template<typename Code>
+  action_wrapper(Code&& code, const permission_level& perm)
+    : code_name(std::forward<Code>(code)), permissions({perm}) {}
+
+  template<typename... Args>
+  void send(Args&&... args) const {
+    action(permissions, code_name, name(Name), std::make_tuple(std::forward<Args>(args)...)).send();
+  }
+
+  name code_name;
+  std::vector<permission_level> permissions;
+};
+
+} // namespace eosio
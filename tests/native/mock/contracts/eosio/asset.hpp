@@ -0,0 +1,111 @@
+#pragma once
+
+#include "datastream.hpp"
+#include "symbol.hpp"
+
+#include <limits>
+#include <string>
+
+namespace eosio {
+
+struct asset {
+  static constexpr int64_t max_amount = (1LL << 62) - 1;
+
+  int64_t amount = 0;
+  eosio::symbol symbol;
+
+  asset() {}
+  asset(int64_t a, eosio::symbol s) : amount(a), symbol{s} {
+    check(is_amount_within_range(), "magnitude of asset amount must be less than 2^62");
+    check(symbol.is_valid(), "invalid symbol name");
+  }
+
+  bool is_amount_within_range() const { return -max_amount <= amount && amount <= max_amount; }
+  bool is_valid() const { return is_amount_within_range() && symbol.is_valid(); }
+  void set_amount(int64_t a) {
+    amount = a;
+    check(is_amount_within_range(), "magnitude of asset amount must be less than 2^62");
+  }
+
+  asset operator-() const {
+    asset r = *this;
+    r.amount = -r.amount;
+    return r;
+  }
+  asset& operator-=(const asset& a) {
+    check(a.symbol == symbol, "attempt to subtract asset with different symbol");
+    amount -= a.amount;
+    check(-max_amount <= amount, "subtraction underflow");
+    check(amount <= max_amount, "subtraction overflow");
+    return *this;
+  }
+  asset& operator+=(const asset& a) {
+    check(a.symbol == symbol, "attempt to add asset with different symbol");
+    amount += a.amount;
+    check(-max_amount <= amount, "addition underflow");
+    check(amount <= max_amount, "addition overflow");
+    return *this;
+  }
+  friend asset operator+(const asset& a, const asset& b) {
+    asset r = a;
+    r += b;
+    return r;
+  }
+  friend asset operator-(const asset& a, const asset& b) {
+    asset r = a;
+    r -= b;
+    return r;
+  }
+  asset& operator*=(int64_t a) {
+    __int128 tmp = (__int128)amount * (__int128)a;
+    check(tmp <= max_amount, "multiplication overflow");
+    check(tmp >= -max_amount, "multiplication underflow");
+    amount = (int64_t)tmp;
+    return *this;
+  }
+  asset& operator/=(int64_t a) {
+    check(a != 0, "divide by zero");
+    check(!(amount == std::numeric_limits<int64_t>::min() && a == -1), "signed division overflow");
+    amount /= a;
+    return *this;
+  }
+
+  friend bool operator==(const asset& a, const asset& b) {
+    check(a.symbol == b.symbol, "comparison of assets with different symbols is not allowed");
+    return a.amount == b.amount;
+  }
+  friend bool operator!=(const asset& a, const asset& b) { return !(a == b); }
+  friend bool operator<(const asset& a, const asset& b) {
+    check(a.symbol == b.symbol, "comparison of assets with different symbols is not allowed");
+    return a.amount < b.amount;
+  }
+  friend bool operator<=(const asset& a, const asset& b) { return !(b < a); }
+  friend bool operator>(const asset& a, const asset& b) { return b < a; }
+  friend bool operator>=(const asset& a, const asset& b) { return !(a < b); }
+
+  std::string to_string() const {
+    int64_t p = symbol.precision();
+    uint64_t mag = amount < 0 ? uint64_t(-amount) : uint64_t(amount);
+    uint64_t scale = 1;
+    for (int64_t i = 0; i < p; ++i) {
+      scale *= 10;
+    }
+    std::string s = (amount < 0 ? "-" : "") + std::to_string(mag / scale);
+    if (p > 0) {
+      std::string frac = std::to_string(mag % scale);
+      s += "." + std::string(p - frac.size(), '0') + frac;
+    }
+    return s + " " + symbol.code().to_string();
+  }
+
+  EOSLIB_SERIALIZE(asset, (amount)(symbol))
+};
+
+struct extended_asset {
+  asset quantity;
+  name contract;
+
+  EOSLIB_SERIALIZE(extended_asset, (quantity)(contract))
+};
+
+} // namespace eosio
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "datastream.hpp"
+
+#include <optional>
+
+namespace eosio {
+
+template<typename T>
+class binary_extension {
+  public:
+    binary_extension() = default;
+    binary_extension(const T& v) : _value(v) {}
+
+    bool has_value() const { return _value.has_value(); }
+    explicit operator bool() const { return has_value(); }
+
+    T& value() {
+      check(has_value(), "cannot get value of empty binary_extension");
+      return *_value;
+    }
+    const T& value() const {
+      check(has_value(), "cannot get value of empty binary_extension");
+      return *_value;
+    }
+    T value_or(const T& def = T()) const { return _value ? *_value : def; }
+
+    T& operator*() { return value(); }
+    const T& operator*() const { return value(); }
+    T* operator->() { return &value(); }
+    const T* operator->() const { return &value(); }
+
+    template<typename... Args>
+    binary_extension& emplace(Args&&... args) {
+      _value.emplace(std::forward<Args>(args)...);
+      return *this;
+    }
+    void reset() { _value.reset(); }
+
+    // only written when present, and only read when bytes remain
+    template<typename DS>
+    friend DS& operator<<(DS& ds, const binary_extension& v) {
+      if (v._value) {
+        ds << *v._value;
+      }
+      return ds;
+    }
+    template<typename DS>
+    friend DS& operator>>(DS& ds, binary_extension& v) {
+      if (ds.remaining()) {
+        T e;
+        ds >> e;
+        v._value = std::move(e);
+      }
+      return ds;
+    }
+
+  private:
+    std::optional<T> _value;
+};
+
+} // namespace eosio
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+namespace mock {
+
+// thrown by `eosio::check`; aborts and rolls back the mock transaction
+struct assertion : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+} // namespace mock
+
+namespace eosio {
+
+inline void check(bool pred, const char* msg) {
+  if (!pred) {
+    throw mock::assertion(msg);
+  }
+}
+
+inline void check(bool pred, const std::string& msg) {
+  if (!pred) {
+    throw mock::assertion(msg);
+  }
+}
+
+inline void check(bool pred, uint64_t code) {
+  if (!pred) {
+    throw mock::assertion("error code " + std::to_string(code));
+  }
+}
+
+} // namespace eosio
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "datastream.hpp"
+
+#include <array>
+
+namespace eosio {
+
+template<size_t Size>
+class fixed_bytes {
+  public:
+    fixed_bytes() : _bytes{} {}
+    explicit fixed_bytes(const std::array<uint8_t, Size>& bytes) : _bytes(bytes) {}
+
+    // the words are stored big-endian, in sequence
+    template<typename Word, typename... Rest>
+    static fixed_bytes make_from_word_sequence(Word first_word, Rest... rest) {
+      static_assert(sizeof(Word) * (1 + sizeof...(Rest)) == Size, "wrong number of words");
+      fixed_bytes r;
+      size_t pos = 0;
+      for (Word w : {first_word, Word(rest)...}) {
+        for (int i = sizeof(Word) - 1; i >= 0; --i) {
+          r._bytes[pos++] = uint8_t(w >> (8 * i));
+        }
+      }
+      return r;
+    }
+
+    std::array<uint8_t, Size> extract_as_byte_array() const { return _bytes; }
+    const uint8_t* data() const { return _bytes.data(); }
+    static constexpr size_t size() { return Size; }
+
+    friend bool operator==(const fixed_bytes& a, const fixed_bytes& b) { return a._bytes == b._bytes; }
+    friend bool operator!=(const fixed_bytes& a, const fixed_bytes& b) { return a._bytes != b._bytes; }
+    friend bool operator<(const fixed_bytes& a, const fixed_bytes& b) { return a._bytes < b._bytes; }
+
+    template<typename DS>
+    friend DS& operator<<(DS& ds, const fixed_bytes& v) {
+      ds.write(v._bytes.data(), Size);
+      return ds;
+    }
+    template<typename DS>
+    friend DS& operator>>(DS& ds, fixed_bytes& v) {
+      ds.read(v._bytes.data(), Size);
+      return ds;
+    }
+
+  private:
+    std::array<uint8_t, Size> _bytes;
+};
+
+using checksum160 = fixed_bytes<20>;
+using checksum256 = fixed_bytes<32>;
+using checksum512 = fixed_bytes<64>;
+
+} // namespace eosio
@@ -0,0 +1,444 @@
+#pragma once
+
+#include "check.hpp"
+#include "name.hpp"
+#include "symbol.hpp"
+
+#include <array>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+   /**
+    * Binary serialization as in the CDT `datastream`. Structs declaring
+    *   EOSLIB_SERIALIZE use their member list; other aggregates (tables, ABI
+    *   structs) are serialized field by field through structured bindings, which
+    *   stands in for the reflection the CDT gets from its compiler plugin.
+    */
+
+#define MOCK_SEQ_CAT(a, b) MOCK_SEQ_CAT_I(a, b)
+#define MOCK_SEQ_CAT_I(a, b) a ## b
+#define MOCK_SEQ_FIELD_A(x) f(this->x); MOCK_SEQ_FIELD_B
+#define MOCK_SEQ_FIELD_B(x) f(this->x); MOCK_SEQ_FIELD_A
+#define MOCK_SEQ_FIELD_A_END
+#define MOCK_SEQ_FIELD_B_END
+
+#define EOSLIB_SERIALIZE(TYPE, MEMBERS) \
+  using eoslib_serialize_tag = void; \
+  template<typename F> void eoslib_for_each_field(F&& f) { \
+    MOCK_SEQ_CAT(MOCK_SEQ_FIELD_A MEMBERS, _END) \
+  } \
+  template<typename F> void eoslib_for_each_field(F&& f) const { \
+    MOCK_SEQ_CAT(MOCK_SEQ_FIELD_A MEMBERS, _END) \
+  }
+
+namespace eosio {
+
+template<typename T>
+class datastream;
+
+template<>
+class datastream<const char*> {
+  public:
+    datastream(const char* start, size_t s) : _start(start), _pos(start), _end(start + s) {}
+
+    void skip(size_t s) {
+      check(size_t(_end - _pos) >= s, "datastream attempted to skip past the end");
+      _pos += s;
+    }
+    bool read(void* d, size_t s) {
+      check(size_t(_end - _pos) >= s, "datastream attempted to read past the end");
+      if (s) {
+        memcpy(d, _pos, s);
+      }
+      _pos += s;
+      return true;
+    }
+    const char* pos() const { return _pos; }
+    size_t tellp() const { return size_t(_pos - _start); }
+    size_t remaining() const { return size_t(_end - _pos); }
+
+  private:
+    const char* _start;
+    const char* _pos;
+    const char* _end;
+};
+
+template<>
+class datastream<char*> {
+  public:
+    datastream(char* start, size_t s) : _start(start), _pos(start), _end(start + s) {}
+
+    bool write(const void* d, size_t s) {
+      check(size_t(_end - _pos) >= s, "datastream attempted to write past the end");
+      if (s) {
+        memcpy(_pos, d, s);
+      }
+      _pos += s;
+      return true;
+    }
+    size_t tellp() const { return size_t(_pos - _start); }
+    size_t remaining() const { return size_t(_end - _pos); }
+
+  private:
+    char* _start;
+    char* _pos;
+    char* _end;
+};
+
+// counts the bytes that would be written
+template<>
+class datastream<size_t> {
+  public:
+    datastream(size_t init = 0) : _size(init) {}
+    bool write(const void*, size_t s) { _size += s; return true; }
+    size_t tellp() const { return _size; }
+    size_t remaining() const { return 0; }
+
+  private:
+    size_t _size;
+};
+
+namespace mock_detail {
+
+template<typename T, typename = void>
+struct has_eoslib_serialize : std::false_type {};
+template<typename T>
+struct has_eoslib_serialize<T, std::void_t<typename T::eoslib_serialize_tag>> : std::true_type {};
+
+template<typename T>
+struct is_std_array : std::false_type {};
+template<typename T, size_t N>
+struct is_std_array<std::array<T, N>> : std::true_type {};
+
+template<typename T>
+constexpr bool is_reflected_v = std::is_class_v<T> && !is_std_array<T>::value
+  && (has_eoslib_serialize<T>::value || std::is_aggregate_v<T>);
+
+struct any_field {
+  template<typename T> operator T() const;
+};
+
+template<typename T, typename... A>
+auto braces_test(int) -> decltype(T{std::declval<A>()...}, std::true_type{});
+template<typename T, typename... A>
+std::false_type braces_test(...);
+
+template<typename T, size_t... I>
+constexpr bool braces_constructible(std::index_sequence<I...>) {
+  return decltype(braces_test<T, decltype((void)I, any_field{})...>(0))::value;
+}
+
+template<typename T, size_t N = 0>
+constexpr size_t field_count() {
+  if constexpr (N > 32 || !braces_constructible<T>(std::make_index_sequence<N + 1>{})) {
+    return N;
+  } else {
+    return field_count<T, N + 1>();
+  }
+}
+
+template<typename T, typename F>
+void for_each_aggregate_field(T& t, F&& f) {
+  constexpr size_t n = field_count<std::remove_const_t<T>>();
+  static_assert(n <= 32, "too many fields for mock reflection");
+  if constexpr (n == 0) {
+  } else if constexpr (n == 1) {
+    auto& [f0] = t;
+    f(f0);
+  } else if constexpr (n == 2) {
+    auto& [f0, f1] = t;
+    f(f0); f(f1);
+  } else if constexpr (n == 3) {
+    auto& [f0, f1, f2] = t;
+    f(f0); f(f1); f(f2);
+  } else if constexpr (n == 4) {
+    auto& [f0, f1, f2, f3] = t;
+    f(f0); f(f1); f(f2); f(f3);
+  } else if constexpr (n == 5) {
+    auto& [f0, f1, f2, f3, f4] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4);
+  } else if constexpr (n == 6) {
+    auto& [f0, f1, f2, f3, f4, f5] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5);
+  } else if constexpr (n == 7) {
+    auto& [f0, f1, f2, f3, f4, f5, f6] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6);
+  } else if constexpr (n == 8) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7);
+  } else if constexpr (n == 9) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8);
+  } else if constexpr (n == 10) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9);
+  } else if constexpr (n == 11) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10);
+  } else if constexpr (n == 12) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11);
+  } else if constexpr (n == 13) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12);
+  } else if constexpr (n == 14) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13);
+  } else if constexpr (n == 15) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14);
+  } else if constexpr (n == 16) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15);
+  } else if constexpr (n == 17) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16);
+  } else if constexpr (n == 18) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17);
+  } else if constexpr (n == 19) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18);
+  } else if constexpr (n == 20) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19);
+  } else if constexpr (n == 21) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19); f(f20);
+  } else if constexpr (n == 22) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19); f(f20); f(f21);
+  } else if constexpr (n == 23) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19); f(f20); f(f21); f(f22);
+  } else if constexpr (n == 24) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19); f(f20); f(f21); f(f22); f(f23);
+  } else if constexpr (n == 25) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19); f(f20); f(f21); f(f22); f(f23); f(f24);
+  } else if constexpr (n == 26) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19); f(f20); f(f21); f(f22); f(f23); f(f24); f(f25);
+  } else if constexpr (n == 27) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19); f(f20); f(f21); f(f22); f(f23); f(f24); f(f25); f(f26);
+  } else if constexpr (n == 28) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19); f(f20); f(f21); f(f22); f(f23); f(f24); f(f25); f(f26); f(f27);
+  } else if constexpr (n == 29) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19); f(f20); f(f21); f(f22); f(f23); f(f24); f(f25); f(f26); f(f27); f(f28);
+  } else if constexpr (n == 30) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28, f29] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19); f(f20); f(f21); f(f22); f(f23); f(f24); f(f25); f(f26); f(f27); f(f28); f(f29);
+  } else if constexpr (n == 31) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28, f29, f30] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19); f(f20); f(f21); f(f22); f(f23); f(f24); f(f25); f(f26); f(f27); f(f28); f(f29); f(f30);
+  } else if constexpr (n == 32) {
+    auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28, f29, f30, f31] = t;
+    f(f0); f(f1); f(f2); f(f3); f(f4); f(f5); f(f6); f(f7); f(f8); f(f9); f(f10); f(f11); f(f12); f(f13); f(f14); f(f15); f(f16); f(f17); f(f18); f(f19); f(f20); f(f21); f(f22); f(f23); f(f24); f(f25); f(f26); f(f27); f(f28); f(f29); f(f30); f(f31);
+  }
+}
+
+template<typename T, typename F>
+void visit_fields(T& t, F&& f) {
+  if constexpr (has_eoslib_serialize<std::remove_const_t<T>>::value) {
+    t.eoslib_for_each_field(f);
+  } else {
+    for_each_aggregate_field(t, f);
+  }
+}
+
+} // namespace mock_detail
+
+template<typename DS, typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+DS& operator<<(DS& ds, const T& v) {
+  ds.write(&v, sizeof(v));
+  return ds;
+}
+
+template<typename DS, typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+DS& operator>>(DS& ds, T& v) {
+  ds.read(&v, sizeof(v));
+  return ds;
+}
+
+template<typename DS, typename T, std::enable_if_t<mock_detail::is_reflected_v<T>, int> = 0>
+DS& operator<<(DS& ds, const T& v) {
+  mock_detail::visit_fields(v, [&](const auto& m) { ds << m; });
+  return ds;
+}
+
+template<typename DS, typename T, std::enable_if_t<mock_detail::is_reflected_v<T>, int> = 0>
+DS& operator>>(DS& ds, T& v) {
+  mock_detail::visit_fields(v, [&](auto& m) { ds >> m; });
+  return ds;
+}
+
+template<typename DS>
+DS& write_varuint32(DS& ds, uint32_t v) {
+  do {
+    uint8_t b = uint8_t(v & 0x7f);
+    v >>= 7;
+    b |= ((v > 0) << 7);
+    ds.write(&b, 1);
+  } while (v);
+  return ds;
+}
+
+template<typename DS>
+uint32_t read_varuint32(DS& ds) {
+  uint64_t v = 0;
+  uint8_t b = 0;
+  uint8_t by = 0;
+  do {
+    ds.read(&b, 1);
+    v |= uint32_t(uint8_t(b) & 0x7f) << by;
+    by += 7;
+  } while (uint8_t(b) & 0x80 && by < 32);
+  return uint32_t(v);
+}
+
+template<typename DS>
+DS& operator<<(DS& ds, const name& v) { return ds << v.value; }
+template<typename DS>
+DS& operator>>(DS& ds, name& v) { return ds >> v.value; }
+
+template<typename DS>
+DS& operator<<(DS& ds, const symbol_code& v) { return ds << v.raw(); }
+template<typename DS>
+DS& operator>>(DS& ds, symbol_code& v) {
+  uint64_t raw = 0;
+  ds >> raw;
+  v = symbol_code(raw);
+  return ds;
+}
+
+template<typename DS>
+DS& operator<<(DS& ds, const symbol& v) { return ds << v.raw(); }
+template<typename DS>
+DS& operator>>(DS& ds, symbol& v) {
+  uint64_t raw = 0;
+  ds >> raw;
+  v = symbol(raw);
+  return ds;
+}
+
+template<typename DS>
+DS& operator<<(DS& ds, const std::string& v) {
+  write_varuint32(ds, uint32_t(v.size()));
+  ds.write(v.data(), v.size());
+  return ds;
+}
+template<typename DS>
+DS& operator>>(DS& ds, std::string& v) {
+  v.resize(read_varuint32(ds));
+  ds.read(v.data(), v.size());
+  return ds;
+}
+
+template<typename DS, typename T>
+DS& operator<<(DS& ds, const std::vector<T>& v) {
+  write_varuint32(ds, uint32_t(v.size()));
+  for (const auto& e : v) {
+    ds << e;
+  }
+  return ds;
+}
+template<typename DS, typename T>
+DS& operator>>(DS& ds, std::vector<T>& v) {
+  v.resize(read_varuint32(ds));
+  for (auto& e : v) {
+    ds >> e;
+  }
+  return ds;
+}
+
+template<typename DS, typename T, size_t N>
+DS& operator<<(DS& ds, const std::array<T, N>& v) {
+  for (const auto& e : v) {
+    ds << e;
+  }
+  return ds;
+}
+template<typename DS, typename T, size_t N>
+DS& operator>>(DS& ds, std::array<T, N>& v) {
+  for (auto& e : v) {
+    ds >> e;
+  }
+  return ds;
+}
+
+template<typename DS, typename T>
+DS& operator<<(DS& ds, const std::optional<T>& v) {
+  ds << bool(v.has_value());
+  if (v) {
+    ds << *v;
+  }
+  return ds;
+}
+template<typename DS, typename T>
+DS& operator>>(DS& ds, std::optional<T>& v) {
+  bool has = false;
+  ds >> has;
+  if (has) {
+    T e;
+    ds >> e;
+    v = std::move(e);
+  } else {
+    v.reset();
+  }
+  return ds;
+}
+
+template<typename DS, typename A, typename B>
+DS& operator<<(DS& ds, const std::pair<A, B>& v) { return ds << v.first << v.second; }
+template<typename DS, typename A, typename B>
+DS& operator>>(DS& ds, std::pair<A, B>& v) { return ds >> v.first >> v.second; }
+
+template<typename DS, typename... A>
+DS& operator<<(DS& ds, const std::tuple<A...>& v) {
+  std::apply([&](const auto&... e) { ((ds << e), ...); }, v);
+  return ds;
+}
+template<typename DS, typename... A>
+DS& operator>>(DS& ds, std::tuple<A...>& v) {
+  std::apply([&](auto&... e) { ((ds >> e), ...); }, v);
+  return ds;
+}
+
+template<typename T>
+size_t pack_size(const T& v) {
+  datastream<size_t> ps;
+  ps << v;
+  return ps.tellp();
+}
+
+template<typename T>
+std::vector<char> pack(const T& v) {
+  std::vector<char> result(pack_size(v));
+  datastream<char*> ds(result.data(), result.size());
+  ds << v;
+  return result;
+}
+
+template<typename T>
+T unpack(const char* buffer, size_t len) {
+  T result;
+  datastream<const char*> ds(buffer, len);
+  ds >> result;
+  return result;
+}
+
+template<typename T>
+T unpack(const std::vector<char>& bytes) {
+  return unpack<T>(bytes.data(), bytes.size());
+}
+
+} // namespace eosio
@@ -0,0 +1,31 @@
+#pragma once
+
+   /**
+    * Host-native stand-in for the CDT <eosio/eosio.hpp>, backed by the in-memory
+    *   chain in tests/native/mock/chain.hpp. It implements only what the contracts
+    *   in this repository use.
+    */
+
+#include "action.hpp"
+#include "asset.hpp"
+#include "binary_extension.hpp"
+#include "check.hpp"
+#include "contract.hpp"
+#include "crypto.hpp"
+#include "datastream.hpp"
+#include "multi_index.hpp"
+#include "name.hpp"
+#include "print.hpp"
+#include "symbol.hpp"
+#include "system.hpp"
+#include "time.hpp"
+#include "varint.hpp"
+
+#include <alloca.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#define CONTRACT class [[eosio::contract]]
+#define ACTION [[eosio::action]] void
+#define TABLE struct [[eosio::table]]
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "check.hpp"
+#include "crypto.hpp"
+
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+   /**
+    * Database interface of the mock chain used by `multi_index` and `singleton`.
+    *   Rows are stored packed, as on chain, so that contracts can read each
+    *   other's tables and row sizes are known. Secondary keys are stored as byte
+    *   strings which sort in the same order as the keys.
+    */
+
+namespace mock {
+
+struct table_id {
+  uint64_t code;
+  uint64_t scope;
+  uint64_t table;
+
+  friend bool operator<(const table_id& a, const table_id& b) {
+    return std::tie(a.code, a.scope, a.table) < std::tie(b.code, b.scope, b.table);
+  }
+};
+
+struct db_row {
+  uint64_t                 payer = 0;
+  std::vector<char>        data;
+  std::vector<std::string> secondary; // one key per index
+};
+
+using db_table = std::map<uint64_t, db_row>;
+using secondary_set = std::set<std::pair<std::string, uint64_t>>;
+
+// nullptr when the table or row does not exist
+const db_table* db_find_table(const table_id& t);
+const db_row* db_get(const table_id& t, uint64_t pk);
+const secondary_set* db_secondary(const table_id& t, size_t index);
+
+// writes are limited to the tables of the executing contract; a zero payer keeps
+//   the payer of an existing row
+void db_set(const table_id& t, uint64_t pk, db_row row);
+void db_remove(const table_id& t, uint64_t pk);
+
+inline std::string key_bytes(uint64_t v) {
+  std::string s(8, '\0');
+  for (int i = 0; i < 8; ++i) {
+    s[i] = char(v >> (56 - 8*i));
+  }
+  return s;
+}
+
+inline std::string key_bytes(unsigned __int128 v) {
+  return key_bytes(uint64_t(v >> 64)) + key_bytes(uint64_t(v));
+}
+
+inline std::string key_bytes(double v) {
+  uint64_t bits;
+  memcpy(&bits, &v, 8);
+  // flip so that unsigned byte order matches numeric order
+  bits = (bits >> 63) ? ~bits : bits | (uint64_t(1) << 63);
+  return key_bytes(bits);
+}
+
+template<size_t Size>
+std::string key_bytes(const eosio::fixed_bytes<Size>& v) {
+  auto b = v.extract_as_byte_array();
+  return std::string(b.begin(), b.end());
+}
+
+} // namespace mock
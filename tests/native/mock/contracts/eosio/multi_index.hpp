@@ -0,0 +1,370 @@
+#pragma once
+
+#include "datastream.hpp"
+#include "mock_db.hpp"
+#include "name.hpp"
+
+#include <iterator>
+#include <memory>
+#include <tuple>
+
+namespace eosio {
+
+typedef unsigned __int128 uint128_t;
+
+static constexpr name same_payer{};
+
+template<class Class, typename Type, Type (Class::*PtrToMemberFunction)() const>
+struct const_mem_fun {
+  typedef std::remove_reference_t<Type> result_type;
+  Type operator()(const Class& x) const { return (x.*PtrToMemberFunction)(); }
+};
+
+template<name::raw IndexName, typename Extractor>
+struct indexed_by {
+  static constexpr name index_name{IndexName};
+  typedef Extractor secondary_extractor_type;
+};
+
+template<name::raw TableName, typename T, typename... Indices>
+class multi_index {
+  public:
+    class const_iterator {
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+
+        const T& operator*() const {
+          check(_mi && !_end, "cannot dereference end iterator");
+          const T* p = _mi->load(_pk);
+          check(p != nullptr, "dereference of deleted object");
+          return *p;
+        }
+        const T* operator->() const { return &**this; }
+
+        const_iterator& operator++() {
+          check(_mi && !_end, "cannot increment end iterator");
+          const mock::db_table* t = mock::db_find_table(_mi->tid());
+          auto it = t ? t->upper_bound(_pk) : mock::db_table::const_iterator();
+          if (!t || it == t->end()) {
+            _end = true;
+          } else {
+            _pk = it->first;
+          }
+          return *this;
+        }
+        const_iterator operator++(int) {
+          const_iterator r = *this;
+          ++*this;
+          return r;
+        }
+        const_iterator& operator--() {
+          const mock::db_table* t = mock::db_find_table(_mi->tid());
+          check(t && !t->empty(), "cannot decrement iterator at beginning of table");
+          auto it = _end ? t->end() : t->lower_bound(_pk);
+          check(it != t->begin(), "cannot decrement iterator at beginning of table");
+          _pk = std::prev(it)->first;
+          _end = false;
+          return *this;
+        }
+        const_iterator operator--(int) {
+          const_iterator r = *this;
+          --*this;
+          return r;
+        }
+
+        friend bool operator==(const const_iterator& a, const const_iterator& b) {
+          return a._mi == b._mi && a._end == b._end && (a._end || a._pk == b._pk);
+        }
+        friend bool operator!=(const const_iterator& a, const const_iterator& b) { return !(a == b); }
+
+      private:
+        friend class multi_index;
+        const_iterator(const multi_index* mi) : _mi(mi) {}
+        const_iterator(const multi_index* mi, uint64_t pk) : _mi(mi), _pk(pk), _end(false) {}
+
+        const multi_index* _mi = nullptr;
+        uint64_t           _pk = 0;
+        bool               _end = true;
+    };
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    template<size_t I, typename Index>
+    class secondary_index {
+      public:
+        typedef std::decay_t<decltype(typename Index::secondary_extractor_type{}(
+          std::declval<const T&>()))> secondary_key_type;
+
+        class const_iterator {
+          public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T*;
+            using reference = const T&;
+
+            const_iterator() = default;
+
+            const T& operator*() const {
+              check(_mi && !_end, "cannot dereference end iterator");
+              return *_mi->load(_pk);
+            }
+            const T* operator->() const { return &**this; }
+
+            const_iterator& operator++() {
+              check(_mi && !_end, "cannot increment end iterator");
+              const mock::secondary_set* s = mock::db_secondary(_mi->tid(), I);
+              auto it = s->upper_bound({_key, _pk});
+              set_position(s, it);
+              return *this;
+            }
+            const_iterator operator++(int) {
+              const_iterator r = *this;
+              ++*this;
+              return r;
+            }
+            const_iterator& operator--() {
+              const mock::secondary_set* s = mock::db_secondary(_mi->tid(), I);
+              check(s && !s->empty(), "cannot decrement iterator at beginning of index");
+              auto it = _end ? s->end() : s->lower_bound({_key, _pk});
+              check(it != s->begin(), "cannot decrement iterator at beginning of index");
+              set_position(s, std::prev(it));
+              return *this;
+            }
+
+            friend bool operator==(const const_iterator& a, const const_iterator& b) {
+              return a._mi == b._mi && a._end == b._end
+                && (a._end || (a._pk == b._pk && a._key == b._key));
+            }
+            friend bool operator!=(const const_iterator& a, const const_iterator& b) {
+              return !(a == b);
+            }
+
+          private:
+            friend class secondary_index;
+            const_iterator(const multi_index* mi) : _mi(mi) {}
+            const_iterator(const multi_index* mi, const mock::secondary_set* s,
+                           mock::secondary_set::const_iterator it) : _mi(mi) {
+              set_position(s, it);
+            }
+            void set_position(const mock::secondary_set* s, mock::secondary_set::const_iterator it) {
+              _end = !s || it == s->end();
+              if (!_end) {
+                _key = it->first;
+                _pk = it->second;
+              }
+            }
+
+            const multi_index* _mi = nullptr;
+            std::string        _key;
+            uint64_t           _pk = 0;
+            bool               _end = true;
+        };
+
+        secondary_index(multi_index* mi) : _mi(mi) {}
+
+        const_iterator begin() const {
+          const mock::secondary_set* s = set();
+          return s ? const_iterator(_mi, s, s->begin()) : end();
+        }
+        const_iterator end() const { return const_iterator(_mi); }
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+
+        const_iterator lower_bound(const secondary_key_type& k) const {
+          const mock::secondary_set* s = set();
+          return s ? const_iterator(_mi, s, s->lower_bound({mock::key_bytes(k), 0})) : end();
+        }
+        const_iterator upper_bound(const secondary_key_type& k) const {
+          const mock::secondary_set* s = set();
+          return s ? const_iterator(_mi, s, s->upper_bound({mock::key_bytes(k), UINT64_MAX})) : end();
+        }
+        const_iterator find(const secondary_key_type& k) const {
+          auto it = lower_bound(k);
+          if (it != end() && it._key != mock::key_bytes(k)) {
+            return end();
+          }
+          return it;
+        }
+        const_iterator require_find(const secondary_key_type& k,
+                                    const char* msg = "unable to find secondary key") const {
+          auto it = find(k);
+          check(it != end(), msg);
+          return it;
+        }
+        const T& get(const secondary_key_type& k, const char* msg = "unable to find secondary key") const {
+          return *require_find(k, msg);
+        }
+        const_iterator iterator_to(const T& obj) const {
+          const mock::secondary_set* s = set();
+          std::string kb = mock::key_bytes(extract(obj));
+          return const_iterator(_mi, s, s->find({kb, obj.primary_key()}));
+        }
+
+        template<typename Lambda>
+        void modify(const_iterator itr, name payer, Lambda&& updater) {
+          _mi->modify(*itr, payer, std::forward<Lambda>(updater));
+        }
+        const_iterator erase(const_iterator itr) {
+          check(itr != end(), "cannot pass end iterator to erase");
+          const T& obj = *itr;
+          ++itr;
+          _mi->erase(obj);
+          return itr;
+        }
+
+        static auto extract(const T& obj) { return typename Index::secondary_extractor_type{}(obj); }
+
+      private:
+        const mock::secondary_set* set() const { return mock::db_secondary(_mi->tid(), I); }
+
+        multi_index* _mi;
+    };
+
+    multi_index(name code, uint64_t scope) : _code(code), _scope(scope) {}
+    multi_index(const multi_index&) = delete;
+    multi_index& operator=(const multi_index&) = delete;
+
+    name get_code() const { return _code; }
+    uint64_t get_scope() const { return _scope; }
+
+    const_iterator begin() const {
+      const mock::db_table* t = mock::db_find_table(tid());
+      return (t && !t->empty()) ? const_iterator(this, t->begin()->first) : end();
+    }
+    const_iterator end() const { return const_iterator(this); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+    const_iterator lower_bound(uint64_t pk) const {
+      const mock::db_table* t = mock::db_find_table(tid());
+      auto it = t ? t->lower_bound(pk) : mock::db_table::const_iterator();
+      return (t && it != t->end()) ? const_iterator(this, it->first) : end();
+    }
+    const_iterator upper_bound(uint64_t pk) const {
+      const mock::db_table* t = mock::db_find_table(tid());
+      auto it = t ? t->upper_bound(pk) : mock::db_table::const_iterator();
+      return (t && it != t->end()) ? const_iterator(this, it->first) : end();
+    }
+
+    uint64_t available_primary_key() const {
+      const mock::db_table* t = mock::db_find_table(tid());
+      if (!t || t->empty()) {
+        return 0;
+      }
+      uint64_t next = t->rbegin()->first + 1;
+      check(next != 0, "next primary key in table is at autoincrement limit");
+      return next;
+    }
+
+    const_iterator find(uint64_t pk) const {
+      return load(pk) ? const_iterator(this, pk) : end();
+    }
+    const_iterator require_find(uint64_t pk, const char* msg = "unable to find key") const {
+      check(load(pk) != nullptr, msg);
+      return const_iterator(this, pk);
+    }
+    const T& get(uint64_t pk, const char* msg = "unable to find key") const {
+      const T* p = load(pk);
+      check(p != nullptr, msg);
+      return *p;
+    }
+    const_iterator iterator_to(const T& obj) const { return const_iterator(this, obj.primary_key()); }
+
+    template<typename Lambda>
+    const_iterator emplace(name payer, Lambda&& constructor) {
+      check(payer.value != 0, "must specify a valid account to pay for new record");
+      auto obj = std::make_unique<T>();
+      constructor(*obj);
+      uint64_t pk = obj->primary_key();
+      check(mock::db_get(tid(), pk) == nullptr,
+        "could not insert object, most likely a uniqueness constraint was violated");
+      mock::db_set(tid(), pk, {payer.value, pack(*obj), secondary_keys(*obj)});
+      _cache[pk] = std::move(obj);
+      return const_iterator(this, pk);
+    }
+
+    template<typename Lambda>
+    void modify(const_iterator itr, name payer, Lambda&& updater) {
+      check(itr != end(), "cannot pass end iterator to modify");
+      modify(*itr, payer, std::forward<Lambda>(updater));
+    }
+
+    template<typename Lambda>
+    void modify(const T& obj, name payer, Lambda&& updater) {
+      uint64_t pk = obj.primary_key();
+      auto c = _cache.find(pk);
+      check(c != _cache.end() && c->second.get() == &obj,
+        "object passed to modify is not in multi_index");
+      T& mutableobj = const_cast<T&>(obj);
+      updater(mutableobj);
+      check(pk == obj.primary_key(), "updater cannot change primary key when modifying an object");
+      mock::db_set(tid(), pk, {payer.value, pack(obj), secondary_keys(obj)});
+    }
+
+    const_iterator erase(const_iterator itr) {
+      check(itr != end(), "cannot pass end iterator to erase");
+      const T& obj = *itr;
+      ++itr;
+      erase(obj);
+      return itr;
+    }
+
+    void erase(const T& obj) {
+      uint64_t pk = obj.primary_key();
+      mock::db_remove(tid(), pk);
+      _cache.erase(pk);
+    }
+
+    template<name::raw IndexName>
+    auto get_index() const {
+      constexpr size_t i = index_number(IndexName);
+      static_assert(i < sizeof...(Indices), "name not among indices");
+      typedef std::tuple_element_t<i, std::tuple<Indices...>> index_t;
+      return secondary_index<i, index_t>(const_cast<multi_index*>(this));
+    }
+
+  private:
+    mock::table_id tid() const { return {_code.value, _scope, uint64_t(TableName)}; }
+
+    static constexpr size_t index_number(name::raw index_name) {
+      constexpr uint64_t names[] = {name(Indices::index_name).value..., 0};
+      for (size_t i = 0; i < sizeof...(Indices); ++i) {
+        if (names[i] == uint64_t(index_name)) {
+          return i;
+        }
+      }
+      return sizeof...(Indices);
+    }
+
+    static std::vector<std::string> secondary_keys(const T& obj) {
+      return { mock::key_bytes(typename Indices::secondary_extractor_type{}(obj))... };
+    }
+
+    // unpacked rows are cached for the life of the table object, as in the CDT
+    const T* load(uint64_t pk) const {
+      auto c = _cache.find(pk);
+      if (c != _cache.end()) {
+        return c->second.get();
+      }
+      const mock::db_row* r = mock::db_get(tid(), pk);
+      if (!r) {
+        return nullptr;
+      }
+      auto obj = std::make_unique<T>(unpack<T>(r->data));
+      return _cache.emplace(pk, std::move(obj)).first->second.get();
+    }
+
+    name     _code;
+    uint64_t _scope;
+    mutable std::map<uint64_t, std::unique_ptr<T>> _cache;
+};
+
+} // namespace eosio
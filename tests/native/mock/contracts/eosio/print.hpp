@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+namespace eosio {
+
+inline void print_one(const char* s) { fputs(s, stderr); }
+inline void print_one(const std::string& s) { fputs(s.c_str(), stderr); }
+template<typename T>
+auto print_one(const T& v) -> decltype(v.to_string(), void()) { print_one(v.to_string()); }
+template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+void print_one(T v) { print_one(std::to_string(v)); }
+
+// console output of the mock goes to stderr, and only when OSWAPS_MOCK_PRINT is defined
+template<typename... Args>
+void print(Args&&... args) {
+#ifdef OSWAPS_MOCK_PRINT
+  (print_one(args), ...);
+#endif
+}
+
+} // namespace eosio
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "datastream.hpp"
+#include "mock_db.hpp"
+#include "name.hpp"
+
+namespace eosio {
+
+template<name::raw SingletonName, typename T>
+class singleton {
+    static constexpr uint64_t pk = uint64_t(SingletonName);
+
+  public:
+    singleton(name code, uint64_t scope) : _code(code), _scope(scope) {}
+
+    bool exists() const { return mock::db_get(tid(), pk) != nullptr; }
+
+    T get() const {
+      const mock::db_row* r = mock::db_get(tid(), pk);
+      check(r != nullptr, "singleton does not exist");
+      return unpack<T>(r->data);
+    }
+
+    T get_or_default(const T& def = T()) const { return exists() ? get() : def; }
+
+    T get_or_create(name bill_to_account, const T& def = T()) {
+      if (exists()) {
+        return get();
+      }
+      set(def, bill_to_account);
+      return def;
+    }
+
+    void set(const T& value, name bill_to_account) {
+      mock::db_set(tid(), pk, {bill_to_account.value, pack(value), {}});
+    }
+
+    void remove() {
+      if (exists()) {
+        mock::db_remove(tid(), pk);
+      }
+    }
+
+  private:
+    mock::table_id tid() const { return {_code.value, _scope, pk}; }
+
+    name     _code;
+    uint64_t _scope;
+};
+
+} // namespace eosio
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "check.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace eosio {
+
+class symbol_code {
+  public:
+    constexpr symbol_code() = default;
+    constexpr explicit symbol_code(uint64_t raw) : value(raw) {}
+    constexpr explicit symbol_code(std::string_view str) {
+      if (str.size() > 7) {
+        check(false, "string is too long to be a valid symbol_code");
+      }
+      for (auto itr = str.rbegin(); itr != str.rend(); ++itr) {
+        if (*itr < 'A' || *itr > 'Z') {
+          check(false, "only uppercase letters allowed in symbol_code string");
+        }
+        value <<= 8;
+        value |= *itr;
+      }
+    }
+
+    constexpr bool is_valid() const {
+      auto sym = value;
+      for (int i = 0; i < 7; i++) {
+        char c = char(sym & 0xFF);
+        if (!('A' <= c && c <= 'Z')) {
+          return false;
+        }
+        sym >>= 8;
+        if (!(sym & 0xFF)) {
+          do {
+            sym >>= 8;
+            if ((sym & 0xFF)) {
+              return false;
+            }
+            i++;
+          } while (i < 7);
+        }
+      }
+      return true;
+    }
+
+    constexpr uint32_t length() const {
+      auto sym = value;
+      uint32_t len = 0;
+      while (sym & 0xFF && len <= 7) {
+        len++;
+        sym >>= 8;
+      }
+      return len;
+    }
+
+    constexpr uint64_t raw() const { return value; }
+    constexpr explicit operator bool() const { return value != 0; }
+
+    std::string to_string() const {
+      std::string s;
+      for (auto v = value; v > 0; v >>= 8) {
+        s += char(v & 0xFF);
+      }
+      return s;
+    }
+
+    friend constexpr bool operator==(const symbol_code& a, const symbol_code& b) {
+      return a.value == b.value;
+    }
+    friend constexpr bool operator!=(const symbol_code& a, const symbol_code& b) {
+      return a.value != b.value;
+    }
+    friend constexpr bool operator<(const symbol_code& a, const symbol_code& b) {
+      return a.value < b.value;
+    }
+
+  private:
+    uint64_t value = 0;
+};
+
+class symbol {
+  public:
+    constexpr symbol() = default;
+    constexpr explicit symbol(uint64_t s) : value(s) {}
+    constexpr symbol(symbol_code sc, uint8_t precision)
+      : value(sc.raw() << 8 | precision) {}
+    constexpr symbol(std::string_view ss, uint8_t precision)
+      : value(symbol_code(ss).raw() << 8 | precision) {}
+
+    constexpr bool is_valid() const { return code().is_valid(); }
+    constexpr uint8_t precision() const { return value & 0xFF; }
+    constexpr symbol_code code() const { return symbol_code{value >> 8}; }
+    constexpr uint64_t raw() const { return value; }
+    constexpr explicit operator bool() const { return value != 0; }
+
+    std::string to_string() const {
+      return std::to_string(precision()) + "," + code().to_string();
+    }
+
+    friend constexpr bool operator==(const symbol& a, const symbol& b) { return a.value == b.value; }
+    friend constexpr bool operator!=(const symbol& a, const symbol& b) { return a.value != b.value; }
+    friend constexpr bool operator<(const symbol& a, const symbol& b) { return a.value < b.value; }
+
+  private:
+    uint64_t value = 0;
+};
+
+} // namespace eosio
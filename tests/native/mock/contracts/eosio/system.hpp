@@ -0,0 +1,10 @@
+#pragma once
+
+#include "time.hpp"
+
+namespace eosio {
+
+// the mock chain's clock; see mock::chain::advance
+time_point current_time_point();
+
+} // namespace eosio
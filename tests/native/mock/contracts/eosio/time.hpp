@@ -0,0 +1,101 @@
+#pragma once
+
+#include "datastream.hpp"
+
+namespace eosio {
+
+class microseconds {
+  public:
+    explicit microseconds(int64_t c = 0) : _count(c) {}
+    int64_t count() const { return _count; }
+    static microseconds maximum() { return microseconds(0x7fffffffffffffffll); }
+
+    friend microseconds operator+(const microseconds& l, const microseconds& r) {
+      return microseconds(l._count + r._count);
+    }
+    friend microseconds operator-(const microseconds& l, const microseconds& r) {
+      return microseconds(l._count - r._count);
+    }
+    friend bool operator==(const microseconds& a, const microseconds& b) { return a._count == b._count; }
+    friend bool operator!=(const microseconds& a, const microseconds& b) { return a._count != b._count; }
+    friend bool operator<(const microseconds& a, const microseconds& b) { return a._count < b._count; }
+    friend bool operator<=(const microseconds& a, const microseconds& b) { return a._count <= b._count; }
+    friend bool operator>(const microseconds& a, const microseconds& b) { return a._count > b._count; }
+    friend bool operator>=(const microseconds& a, const microseconds& b) { return a._count >= b._count; }
+
+    int64_t _count;
+    EOSLIB_SERIALIZE(microseconds, (_count))
+};
+
+inline microseconds seconds(int64_t s) { return microseconds(s * 1000000); }
+inline microseconds milliseconds(int64_t s) { return microseconds(s * 1000); }
+inline microseconds minutes(int64_t m) { return seconds(60 * m); }
+inline microseconds hours(int64_t h) { return minutes(60 * h); }
+inline microseconds days(int64_t d) { return hours(24 * d); }
+
+class time_point {
+  public:
+    explicit time_point(microseconds e = microseconds()) : elapsed(e) {}
+    const microseconds& time_since_epoch() const { return elapsed; }
+    uint32_t sec_since_epoch() const { return uint32_t(elapsed.count() / 1000000); }
+
+    time_point& operator+=(const microseconds& m) {
+      elapsed = elapsed + m;
+      return *this;
+    }
+    time_point operator+(const microseconds& m) const { return time_point(elapsed + m); }
+    time_point operator-(const microseconds& m) const { return time_point(elapsed - m); }
+    microseconds operator-(const time_point& m) const { return elapsed - m.elapsed; }
+    bool operator==(const time_point& t) const { return elapsed == t.elapsed; }
+    bool operator!=(const time_point& t) const { return elapsed != t.elapsed; }
+    bool operator<(const time_point& t) const { return elapsed < t.elapsed; }
+    bool operator<=(const time_point& t) const { return elapsed <= t.elapsed; }
+    bool operator>(const time_point& t) const { return elapsed > t.elapsed; }
+    bool operator>=(const time_point& t) const { return elapsed >= t.elapsed; }
+
+    microseconds elapsed;
+    EOSLIB_SERIALIZE(time_point, (elapsed))
+};
+
+class time_point_sec {
+  public:
+    time_point_sec() : utc_seconds(0) {}
+    explicit time_point_sec(uint32_t seconds) : utc_seconds(seconds) {}
+    time_point_sec(const time_point& t) : utc_seconds(t.sec_since_epoch()) {}
+
+    static time_point_sec maximum() { return time_point_sec(0xffffffff); }
+    static time_point_sec min() { return time_point_sec(0); }
+
+    operator time_point() const { return time_point(eosio::seconds(utc_seconds)); }
+    uint32_t sec_since_epoch() const { return utc_seconds; }
+
+    time_point_sec operator+(uint32_t offset) const { return time_point_sec(utc_seconds + offset); }
+    time_point_sec operator-(uint32_t offset) const { return time_point_sec(utc_seconds - offset); }
+    time_point_sec& operator+=(uint32_t offset) {
+      utc_seconds += offset;
+      return *this;
+    }
+    friend bool operator==(const time_point_sec& a, const time_point_sec& b) {
+      return a.utc_seconds == b.utc_seconds;
+    }
+    friend bool operator!=(const time_point_sec& a, const time_point_sec& b) {
+      return a.utc_seconds != b.utc_seconds;
+    }
+    friend bool operator<(const time_point_sec& a, const time_point_sec& b) {
+      return a.utc_seconds < b.utc_seconds;
+    }
+    friend bool operator<=(const time_point_sec& a, const time_point_sec& b) {
+      return a.utc_seconds <= b.utc_seconds;
+    }
+    friend bool operator>(const time_point_sec& a, const time_point_sec& b) {
+      return a.utc_seconds > b.utc_seconds;
+    }
+    friend bool operator>=(const time_point_sec& a, const time_point_sec& b) {
+      return a.utc_seconds >= b.utc_seconds;
+    }
+
+    uint32_t utc_seconds;
+    EOSLIB_SERIALIZE(time_point_sec, (utc_seconds))
+};
+
+} // namespace eosio
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "action.hpp"
+#include "time.hpp"
+#include "varint.hpp"
+
+#include <cstddef>
+
+extern "C" {
+size_t read_transaction(char* buffer, size_t size);
+size_t transaction_size();
+}
+
+namespace eosio {
+
+struct transaction {
+  time_point_sec expiration;
+  uint16_t ref_block_num = 0;
+  uint32_t ref_block_prefix = 0;
+  unsigned_int max_net_usage_words = 0;
+  uint8_t max_cpu_usage_ms = 0;
+  unsigned_int delay_sec = 0;
+  std::vector<action> context_free_actions;
+  std::vector<action> actions;
+  std::vector<std::pair<uint16_t, std::vector<char>>> transaction_extensions;
+
+  EOSLIB_SERIALIZE(transaction, (expiration)(ref_block_num)(ref_block_prefix)
+    (max_net_usage_words)(max_cpu_usage_ms)(delay_sec)
+    (context_free_actions)(actions)(transaction_extensions))
+};
+
+} // namespace eosio
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "datastream.hpp"
+
+namespace eosio {
+
+struct unsigned_int {
+  unsigned_int(uint32_t v = 0) : value(v) {}
+  template<typename T>
+  unsigned_int(T v) : value(uint32_t(v)) {}
+
+  operator uint32_t() const { return value; }
+
+  uint32_t value;
+
+  template<typename DS>
+  friend DS& operator<<(DS& ds, const unsigned_int& v) { return write_varuint32(ds, v.value); }
+  template<typename DS>
+  friend DS& operator>>(DS& ds, unsigned_int& v) {
+    v.value = read_varuint32(ds);
+    return ds;
+  }
+};
+
+} // namespace eosio
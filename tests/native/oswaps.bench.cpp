@@ -0,0 +1,366 @@
+// Host-native benchmarks of oswaps actions on the in-memory chain mock
+//
+//   cmake -S tests/native -B build/native && cmake --build build/native
+//   build/native/oswaps_bench [--quick] [--filter=<substring>]
+//
+// Every benchmark runs complete transactions (prep action + token transfer, etc.)
+// through the token and oswaps contracts compiled for the host, so the binary can
+// be profiled with e.g.
+//   perf record -g build/native/oswaps_bench --filter=swap/500
+//   valgrind --tool=callgrind build/native/oswaps_bench --quick --filter=swap/50
+// Times include the mock's packing and dispatch, which are not part of the
+// on-chain cost; compare like with like.
+
+#include "contracts.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using eosio::asset;
+using eosio::name;
+using eosio::permission_level;
+using eosio::symbol;
+
+static const name token_acct = "token"_n;
+static const name oswaps_acct = "oswaps"_n;
+static const name manager = "manager"_n;
+static const name lp = "lp"_n;
+static const name trader = "trader"_n;
+
+// row of the oswaps tokensa table
+struct asset_row {
+  uint64_t          token_id;
+  uint16_t          chain;
+  name              contract_name;
+  eosio::symbol_code symbol;
+  bool              active;
+  uint64_t          weight;
+  asset             balance;
+  eosio::symbol     liq_symbol;
+  uint64_t          fee_rate;
+  unsigned __int128 fee_growth;
+  asset             fees;
+  int64_t           limit_capacity;
+  int64_t           limit_refill;
+  int64_t           limit_level;
+  uint32_t          limit_updated;
+  asset             deposits;
+  unsigned __int128 price_cum;
+  uint32_t          price_updated;
+};
+// an operation of the oswaps batch action
+struct batch_op {
+  name     op;
+  uint64_t token_id;
+  uint64_t out_token_id;
+  asset    amount;
+  int64_t  min_out;
+  float    weight;
+};
+// row of the token contract's accounts table
+struct account_row {
+  asset balance;
+};
+
+// typical createasseta metadata
+static const std::string metadata =
+  "{\"name\":\"Benchmark token\",\"logo\":\"https://example.org/logos/token.svg\","
+  "\"website\":\"https://example.org\",\"description\":\"A community currency used to "
+  "benchmark oswaps\"}";
+
+static bool quick = false;
+static const char* filter = "";
+static int failures = 0;
+
+static symbol token_symbol(size_t i) {
+  std::string code = "T";
+  for (int d = 0; d < 4; ++d, i /= 26) {
+    code += char('A' + i % 26);
+  }
+  return symbol(eosio::symbol_code(code), 4);
+}
+
+static asset amount(size_t i, int64_t units) {
+  return asset(units * 10000, token_symbol(i));
+}
+
+template<typename... Args>
+static eosio::action act(name contract, name action, name actor, Args... args) {
+  return eosio::action(permission_level(actor, "active"_n), contract, action,
+                       std::make_tuple(args...));
+}
+
+static void require(const mock::push_result& r, const char* what) {
+  if (!r) {
+    fprintf(stderr, "%s failed: %s\n", what, r.error.c_str());
+    exit(1);
+  }
+}
+
+// a pool of `n` tokens, each with liquidity 1000000, weight 1.0, a 0.3% fee and a rate
+//   limit that the benchmarks stay within; the trader has deposited 100000 of each
+struct pool {
+  mock::chain c;
+  size_t      n;
+
+  explicit pool(size_t tokens) : n(tokens) {
+    for (name a : {manager, lp, trader}) {
+      c.create_account(a);
+    }
+    set_token_contract(c, token_acct);
+    set_oswaps_contract(c, oswaps_acct);
+    require(c.push_action(oswaps_acct, "init"_n, permission_level(oswaps_acct, "owner"_n),
+                          manager, std::string("Telos")), "init");
+    require(c.push_action(oswaps_acct, "setbatch"_n, permission_level(manager, "active"_n),
+                          manager, uint32_t(1)), "setbatch");
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t id = i + 1;
+      std::string sym = token_symbol(i).code().to_string();
+      require(c.push_transaction({
+        act(token_acct, "create"_n, token_acct, lp, amount(i, 100000000)),
+        act(token_acct, "issue"_n, lp, lp, amount(i, 100000000), std::string()),
+        act(token_acct, "transfer"_n, lp, lp, trader, amount(i, 1000000), std::string()),
+        act(oswaps_acct, "createasseta"_n, lp, lp, std::string("Telos"), token_acct,
+            token_symbol(i).code(), metadata),
+        act(oswaps_acct, "unfreeze"_n, manager, manager, id, sym) }), "create token");
+      require(c.push_transaction({
+        act(oswaps_acct, "addliqprep2"_n, lp, lp, id, amount(i, 1000000), 1.0f),
+        act(token_acct, "transfer"_n, lp, lp, oswaps_acct, amount(i, 1000000), std::string()) }),
+        "add liquidity");
+      require(c.push_action(oswaps_acct, "unfreeze"_n, permission_level(manager, "active"_n),
+                            manager, id, sym), "unfreeze");
+      require(c.push_action(oswaps_acct, "setfee"_n, permission_level(manager, "active"_n),
+                            manager, id, sym, 0.003f), "setfee");
+      require(c.push_action(oswaps_acct, "setlimit"_n, permission_level(manager, "active"_n),
+                            manager, id, amount(i, 1000000), amount(i, 1000)), "setlimit");
+      require(c.push_action(token_acct, "transfer"_n, permission_level(trader, "active"_n),
+                            trader, oswaps_acct, amount(i, 100000), std::string("#D")), "deposit");
+    }
+  }
+
+  std::vector<uint64_t> ids() const {
+    std::vector<uint64_t> r;
+    for (size_t i = 0; i < n; ++i) {
+      r.push_back(i + 1);
+    }
+    return r;
+  }
+
+  // the pool balances, fees and deposits recorded by oswaps must equal its token holdings
+  void check_ledger(const char* bench) {
+    auto held = c.rows<account_row>(token_acct, oswaps_acct.value, "accounts"_n);
+    for (const asset_row& e : c.rows<asset_row>(oswaps_acct, oswaps_acct.value, "tokensa"_n)) {
+      bool found = false;
+      for (const account_row& a : held) {
+        if (a.balance.symbol == e.balance.symbol) {
+          found = a.balance == e.balance + e.fees + e.deposits;
+        }
+      }
+      if (!found) {
+        printf("FAIL %s: pool balance %s, fees %s and deposits %s of token %llu do not match"
+               " holdings\n", bench, e.balance.to_string().c_str(), e.fees.to_string().c_str(),
+               e.deposits.to_string().c_str(), (unsigned long long)e.token_id);
+        ++failures;
+        return;
+      }
+    }
+  }
+};
+
+// distinct token indexes for iteration i
+static size_t in_index(const pool& p, size_t i) { return i % p.n; }
+static size_t out_index(const pool& p, size_t i) {
+  return (in_index(p, i) + 1 + (i / p.n) % (p.n - 1)) % p.n;
+}
+
+static mock::push_result swap(pool& p, size_t i) {
+  size_t a = in_index(p, i);
+  size_t b = out_index(p, i);
+  return p.c.push_transaction({
+    act(oswaps_acct, "exprepfrom2"_n, trader, trader, trader, uint64_t(a + 1), uint64_t(b + 1),
+        amount(a, 1), std::string()),
+    act(token_acct, "transfer"_n, trader, trader, oswaps_acct, amount(a, 1), std::string()) });
+}
+
+// a swap in a new second, which advances both price accumulators
+static mock::push_result swap_tick(pool& p, size_t i) {
+  p.c.advance(1);
+  return swap(p, i);
+}
+
+// a swap between internal deposit balances
+static mock::push_result swap_int(pool& p, size_t i) {
+  size_t a = in_index(p, i);
+  size_t b = out_index(p, i);
+  return p.c.push_action(oswaps_acct, "swapint"_n, permission_level(trader, "active"_n), trader,
+                         uint64_t(a + 1), uint64_t(b + 1), amount(a, 1), int64_t(0));
+}
+
+// four consecutive swaps between internal deposits, as separate swapint actions
+static mock::push_result swap4_int(pool& p, size_t i) {
+  size_t a = in_index(p, i);
+  std::vector<eosio::action> swaps;
+  for (size_t k = 0; k < 4; ++k) {
+    size_t in = (a + k) % p.n;
+    size_t out = (a + k + 1) % p.n;
+    swaps.push_back(act(oswaps_acct, "swapint"_n, trader, trader, uint64_t(in + 1),
+                        uint64_t(out + 1), amount(in, 1), int64_t(0)));
+  }
+  return p.c.push_transaction(swaps);
+}
+
+// the same four swaps as one batch, settled net against deposits and transfers
+static mock::push_result swap4_batch(pool& p, size_t i) {
+  size_t a = in_index(p, i);
+  std::vector<batch_op> ops;
+  for (size_t k = 0; k < 4; ++k) {
+    size_t in = (a + k) % p.n;
+    size_t out = (a + k + 1) % p.n;
+    ops.push_back({"swap"_n, uint64_t(in + 1), uint64_t(out + 1), amount(in, 1), 0, 0.0f});
+  }
+  return p.c.push_action(oswaps_acct, "batch"_n, permission_level(trader, "active"_n), trader, ops);
+}
+
+static mock::push_result swap_memo(pool& p, size_t i) {
+  size_t a = in_index(p, i);
+  size_t b = out_index(p, i);
+  return p.c.push_transaction({
+    act(token_acct, "transfer"_n, trader, trader, oswaps_acct, amount(a, 1),
+        "#F," + std::to_string(b + 1) + ",,0") });
+}
+
+static mock::push_result route(pool& p, size_t i) {
+  size_t a = in_index(p, i);
+  size_t b = out_index(p, i);
+  size_t c = (b + 1) % p.n == a ? (b + 2) % p.n : (b + 1) % p.n;
+  std::vector<uint64_t> path{a + 1, b + 1, c + 1};
+  return p.c.push_transaction({
+    act(oswaps_acct, "exroute"_n, trader, trader, trader, path, amount(a, 1), asset(0, token_symbol(c)),
+        std::string()),
+    act(token_acct, "transfer"_n, trader, trader, oswaps_acct, amount(a, 1), std::string()) });
+}
+
+static mock::push_result addliq(pool& p, size_t i) {
+  size_t a = in_index(p, i);
+  return p.c.push_transaction({
+    act(oswaps_acct, "addliqprep2"_n, lp, lp, uint64_t(a + 1), amount(a, 1), 0.0f),
+    act(token_acct, "transfer"_n, lp, lp, oswaps_acct, amount(a, 1), std::string()) });
+}
+
+static mock::push_result withdraw(pool& p, size_t i) {
+  size_t a = in_index(p, i);
+  return p.c.push_transaction({
+    act(oswaps_acct, "withdraw2"_n, manager, lp, uint64_t(a + 1), amount(a, 1), 0.0f) });
+}
+
+// queues 8 withdrawals and cranks them; NET and RAM are those of the crank
+static mock::push_result crank8(pool& p, size_t i) {
+  std::vector<eosio::action> requests;
+  for (size_t k = 0; k < 8; ++k) {
+    size_t a = in_index(p, i * 8 + k);
+    requests.push_back(act(oswaps_acct, "withdrawq"_n, manager, lp, uint64_t(a + 1), amount(a, 1)));
+  }
+  require(p.c.push_transaction(requests), "withdrawq");
+  return p.c.push_transaction({ act(oswaps_acct, "crank"_n, trader, uint32_t(8)) });
+}
+
+// escrows 8 opposing swap intents on one pair and settles them; NET and RAM are those
+//   of the settlement
+static mock::push_result batch8(pool& p, size_t i) {
+  size_t a = in_index(p, i);
+  size_t b = out_index(p, i);
+  for (size_t k = 0; k < 8; ++k) {
+    size_t in = k % 2 ? b : a;
+    size_t out = k % 2 ? a : b;
+    require(p.c.push_transaction({
+      act(token_acct, "transfer"_n, trader, trader, oswaps_acct, amount(in, 200 + k),
+          "#B," + std::to_string(out + 1) + ",,0") }), "batch intent");
+  }
+  p.c.advance(1);
+  return p.c.push_transaction({ act(oswaps_acct, "settle"_n, trader, uint32_t(8)) });
+}
+
+static mock::push_result querypool(pool& p, size_t) {
+  return p.c.push_action(oswaps_acct, "querypool"_n, permission_level(trader, "active"_n), p.ids());
+}
+
+// the first page of the pool, as a wallet syncing it would read
+static mock::push_result querypage(pool& p, size_t) {
+  return p.c.push_action(oswaps_acct, "querypage"_n, permission_level(trader, "active"_n),
+                         uint64_t(0), uint32_t(0));
+}
+
+static mock::push_result querypool_all(pool& p, size_t) {
+  return p.c.push_action(oswaps_acct, "querypool"_n, permission_level(trader, "active"_n),
+                         std::vector<uint64_t>());
+}
+
+typedef mock::push_result (*bench_fn)(pool&, size_t);
+
+static void run(const char* label, bench_fn f, size_t n) {
+  std::string name = std::string(label) + "/" + std::to_string(n);
+  if (!strstr(name.c_str(), filter)) {
+    return;
+  }
+  pool p(n);
+  const double min_seconds = quick ? 0.0 : 0.2;
+  const size_t max_iterations = quick ? 10 : 20000;
+  int64_t ram_before = p.c.ram_usage(oswaps_acct);
+  size_t net = 0;
+  size_t iterations = 0;
+  double seconds = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  while (iterations < max_iterations && (iterations < 10 || seconds < min_seconds)) {
+    auto r = f(p, iterations++);
+    require(r, name.c_str());
+    net += r.net_bytes;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  }
+  double ram = double(p.c.ram_usage(oswaps_acct) - ram_before) / iterations;
+  printf("%-18s %12.0f ns %10zu %10.0f %10.1f\n", name.c_str(), seconds * 1e9 / iterations,
+         iterations, double(net) / iterations, ram);
+  p.check_ledger(name.c_str());
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--quick")) {
+      quick = true;
+    } else if (!strncmp(argv[i], "--filter=", 9)) {
+      filter = argv[i] + 9;
+    } else {
+      fprintf(stderr, "usage: %s [--quick] [--filter=<substring>]\n", argv[0]);
+      return 2;
+    }
+  }
+  const std::vector<size_t> sizes = quick ? std::vector<size_t>{2, 10}
+                                          : std::vector<size_t>{2, 10, 50, 100, 500};
+  printf("%-18s %15s %10s %10s %10s\n", "Benchmark", "Time", "Iterations", "NET bytes",
+         "RAM bytes");
+  for (size_t n : sizes) {
+    run("swap", swap, n);
+    run("swap_tick", swap_tick, n);
+    run("swap_memo", swap_memo, n);
+    run("swap_int", swap_int, n);
+    run("swap4_int", swap4_int, n);
+    run("swap4_batch", swap4_batch, n);
+    if (n >= 3) {
+      run("route", route, n);
+    }
+    run("addliq", addliq, n);
+    run("withdraw", withdraw, n);
+    run("crank8", crank8, n);
+    run("batch8", batch8, n);
+    run("querypool", querypool, n);
+    if (n <= 100) {
+      run("querypool_all", querypool_all, n);
+    }
+    run("querypage", querypage, n);
+  }
+  if (failures) {
+    printf("%d FAILED\n", failures);
+  }
+  return failures ? 1 : 0;
+}
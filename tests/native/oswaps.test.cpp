@@ -0,0 +1,606 @@
+// Native specs of oswaps contract behaviour on the in-memory chain mock
+//
+//   cmake -S tests/native -B build/native && cmake --build build/native
+//   ctest --test-dir build/native
+//
+// For cases the Vert specs (tests/contract.spec.ts) cannot express, such as a
+// third contract forwarding notifications.
+
+#include "contracts.hpp"
+
+#include <eosio/crypto.hpp>
+#include <eosio/singleton.hpp>
+
+#include <cstdio>
+#include <string>
+
+using eosio::asset;
+using eosio::name;
+using eosio::permission_level;
+using eosio::symbol;
+
+static int failures = 0;
+
+#define EXPECT(cond, ...) do { if (!(cond)) { ++failures; \
+  printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static const name token_acct = "token"_n;
+static const name oswaps_acct = "oswaps"_n;
+static const name manager = "manager"_n;
+static const name lp = "lp"_n;
+static const name attacker = "attacker"_n;
+static const name relay = "relay"_n;
+
+static const symbol abc(eosio::symbol_code("ABC"), 4);
+static const symbol xyz(eosio::symbol_code("XYZ"), 4);
+
+// leading fields of a row of the oswaps tokensa table
+struct asset_head {
+  uint64_t          token_id;
+  uint16_t          chain;
+  name              contract_name;
+  eosio::symbol_code symbol;
+  bool              active;
+  uint64_t          weight;
+  asset             balance;
+};
+// row of an accounts table
+struct account_row {
+  asset balance;
+};
+
+template<typename... Args>
+static eosio::action act(name contract, name action, name actor, Args... args) {
+  return eosio::action(permission_level(actor, "active"_n), contract, action,
+                       std::make_tuple(args...));
+}
+
+static int64_t balance_of(const mock::chain& c, name code, name owner, symbol sym) {
+  for (const account_row& r : c.rows<account_row>(code, owner.value, "accounts"_n)) {
+    if (r.balance.symbol == sym) {
+      return r.balance.amount;
+    }
+  }
+  return 0;
+}
+
+// a pool of ABC (token 1) and XYZ (token 2), 10000 of each at equal weights, and an
+//   attacker holding 1000 of each; `relay` forwards every transfer notification it
+//   receives to oswaps, as any contract may
+struct pool {
+  mock::chain c;
+
+  pool() {
+    for (name a : {manager, lp, attacker}) {
+      c.create_account(a);
+    }
+    set_token_contract(c, token_acct);
+    set_oswaps_contract(c, oswaps_acct);
+    c.set_notify(relay, "transfer"_n, [](name, name, const std::vector<char>&) {
+      eosio::require_recipient(oswaps_acct);
+    });
+    expect_ok(c.push_action(oswaps_acct, "init"_n, permission_level(oswaps_acct, "owner"_n),
+                            manager, std::string("Telos")), "init");
+    uint64_t id = 1;
+    for (symbol s : {abc, xyz}) {
+      std::string code = s.code().to_string();
+      expect_ok(c.push_transaction({
+        act(token_acct, "create"_n, token_acct, lp, asset(1000000000, s)),
+        act(token_acct, "issue"_n, lp, lp, asset(1000000000, s), std::string()),
+        act(token_acct, "transfer"_n, lp, lp, attacker, asset(10000000, s), std::string()),
+        act(oswaps_acct, "createasseta"_n, lp, lp, std::string("Telos"), token_acct, s.code(),
+            std::string()),
+        act(oswaps_acct, "unfreeze"_n, manager, manager, id, code) }), "create token");
+      expect_ok(c.push_transaction({
+        act(oswaps_acct, "addliqprep2"_n, lp, lp, id, asset(100000000, s), 1.0f),
+        act(token_acct, "transfer"_n, lp, lp, oswaps_acct, asset(100000000, s), std::string()) }),
+        "add liquidity");
+      expect_ok(c.push_action(oswaps_acct, "unfreeze"_n, permission_level(manager, "active"_n),
+                              manager, id, code), "unfreeze");
+      ++id;
+    }
+  }
+
+  static void expect_ok(const mock::push_result& r, const char* what) {
+    EXPECT(r, "%s: %s", what, r.error.c_str());
+  }
+
+  int64_t held(symbol s) const { return balance_of(c, token_acct, oswaps_acct, s); }
+
+  std::vector<asset_head> assets() const {
+    return c.rows<asset_head>(oswaps_acct, oswaps_acct.value, "tokensa"_n);
+  }
+
+  // the attacker pays the relay, which forwards the notification to oswaps
+  mock::push_result forward(symbol s, int64_t amount, const std::string& memo) {
+    return c.push_action(token_acct, "transfer"_n, permission_level(attacker, "active"_n),
+                         attacker, relay, asset(amount, s), memo);
+  }
+};
+
+static void test_forwarded_swap() {
+  pool p;
+  auto before = p.assets();
+  for (const char* memo : {"#F,2,,0", "#T,2,,10000"}) {
+    auto r = p.forward(abc, 1000000, memo);
+    EXPECT(r, "forwarded %s: %s", memo, r.error.c_str());
+  }
+  EXPECT(balance_of(p.c, token_acct, attacker, xyz) == 10000000, "forwarded swap paid out");
+  EXPECT(p.held(xyz) == 100000000, "oswaps XYZ holdings changed");
+  auto after = p.assets();
+  EXPECT(after[0].balance == before[0].balance && after[1].balance == before[1].balance,
+         "forwarded swap changed pool balances");
+}
+
+// row of the oswaps intents table
+struct intent_row {
+  uint64_t id;
+  uint32_t closes;
+  name     sender;
+  name     recipient;
+  name     in_contract;
+  uint64_t in_token_id;
+  uint64_t out_token_id;
+  asset    in_amount;
+  int64_t  min_out;
+};
+
+static std::vector<intent_row> intents(const pool& p) {
+  return p.c.rows<intent_row>(oswaps_acct, oswaps_acct.value, "intents"_n);
+}
+
+static void test_forwarded_intent() {
+  pool p;
+  pool::expect_ok(p.c.push_action(oswaps_acct, "setbatch"_n, permission_level(manager, "active"_n),
+                                  manager, uint32_t(60)), "setbatch");
+  auto r = p.forward(abc, 1000000, "#B,2,,0");
+  EXPECT(r, "forwarded #B: %s", r.error.c_str());
+  EXPECT(intents(p).empty(), "forwarded transfer escrowed an intent");
+}
+
+static void test_settle_budget() {
+  pool p;
+  pool::expect_ok(p.c.push_action(oswaps_acct, "setbatch"_n, permission_level(manager, "active"_n),
+                                  manager, uint32_t(60)), "setbatch");
+  auto r = p.c.push_action(token_acct, "transfer"_n, permission_level(attacker, "active"_n),
+                           attacker, oswaps_acct, asset(9999, abc), std::string("#B,2,,0"));
+  EXPECT(r.error == "eosio_assert: batch intent is below the minimum size",
+         "dust intent: %s", r.error.c_str());
+  for (int k = 0; k < 5; ++k) {
+    pool::expect_ok(p.c.push_action(token_acct, "transfer"_n, permission_level(attacker, "active"_n),
+                                    attacker, oswaps_acct, asset(100000 + k, k % 2 ? xyz : abc),
+                                    std::string(k % 2 ? "#B,1,,0" : "#B,2,,0")), "intent");
+  }
+  p.c.advance(60);
+  pool::expect_ok(p.c.push_action(oswaps_acct, "settle"_n, permission_level(attacker, "active"_n),
+                                  uint32_t(3)), "settle 3");
+  auto left = intents(p);
+  EXPECT(left.size() == 2 && left[0].id == 3, "settle did not stop after 3 intents");
+  pool::expect_ok(p.c.push_action(oswaps_acct, "settle"_n, permission_level(attacker, "active"_n),
+                                  uint32_t(3)), "settle rest");
+  EXPECT(intents(p).empty(), "intents left after settling the rest");
+  EXPECT(p.held(abc) == p.assets()[0].balance.amount && p.held(xyz) == p.assets()[1].balance.amount,
+         "holdings differ from pool balances after settlement");
+}
+
+// row of an oswaps deposits table
+struct deposit_row {
+  uint64_t token_id;
+  asset    balance;
+};
+
+// leading fields of a tokensa row, through the deposit total
+struct asset_deposits {
+  uint64_t          token_id;
+  uint16_t          chain;
+  name              contract_name;
+  eosio::symbol_code symbol;
+  bool              active;
+  uint64_t          weight;
+  asset             balance;
+  eosio::symbol     liq_symbol;
+  uint64_t          fee_rate;
+  unsigned __int128 fee_growth;
+  asset             fees;
+  int64_t           limit_capacity;
+  int64_t           limit_refill;
+  int64_t           limit_level;
+  uint32_t          limit_updated;
+  asset             deposits;
+};
+
+static void test_deposits() {
+  pool p;
+  const name victim = "victim"_n;
+  p.c.create_account(victim);
+  // a forwarded deposit credits nothing, so nothing can be withdrawn
+  auto r = p.forward(abc, 1000000, "#D");
+  EXPECT(r, "forwarded #D: %s", r.error.c_str());
+  EXPECT(p.c.rows<deposit_row>(oswaps_acct, attacker.value, "deposits"_n).empty(),
+         "forwarded transfer credited a deposit");
+  r = p.c.push_action(oswaps_acct, "depwithdraw"_n, permission_level(attacker, "active"_n),
+                      attacker, uint64_t(1), asset(1000000, abc));
+  EXPECT(r.error == "eosio_assert: insufficient deposit", "depwithdraw: %s", r.error.c_str());
+  EXPECT(p.held(abc) == 100000000, "oswaps ABC holdings changed");
+  // deposit rows for other accounts are not created at the contract's expense
+  r = p.c.push_action(token_acct, "transfer"_n, permission_level(attacker, "active"_n),
+                      attacker, oswaps_acct, asset(1, abc), std::string("#D,victim"));
+  EXPECT(r.error == "eosio_assert: recipient has no deposit of this token",
+         "deposit for another account: %s", r.error.c_str());
+  pool::expect_ok(p.c.push_action(token_acct, "transfer"_n, permission_level(attacker, "active"_n),
+                                  attacker, oswaps_acct, asset(500000, abc), std::string("#D")),
+                  "deposit");
+  pool::expect_ok(p.c.push_action(token_acct, "transfer"_n, permission_level(lp, "active"_n),
+                                  lp, oswaps_acct, asset(1, abc), std::string("#D,attacker")),
+                  "deposit for an existing row");
+  // resetacct returns erased deposits to the pool's reach
+  pool::expect_ok(p.c.push_action(oswaps_acct, "resetacct"_n,
+                                  permission_level(oswaps_acct, "owner"_n), attacker, uint32_t(10)),
+                  "resetacct");
+  auto a = p.c.rows<asset_deposits>(oswaps_acct, oswaps_acct.value, "tokensa"_n);
+  EXPECT(a[0].deposits.amount == 0, "deposit total %lld after resetacct",
+         (long long)a[0].deposits.amount);
+  pool::expect_ok(p.c.push_action(oswaps_acct, "reconcile"_n, permission_level(manager, "active"_n),
+                                  manager, uint64_t(1)), "reconcile");
+  EXPECT(p.assets()[0].balance.amount == p.held(abc), "reconcile left deposits out of the pool");
+}
+
+// the asset row of the original contract, with its chain index
+struct baseline_asset {
+  uint64_t           token_id;
+  eosio::checksum256 chain_code;
+  name               contract_name;
+  eosio::symbol_code symbol;
+  bool               active;
+  std::string        metadata;
+  float              weight;
+
+  uint64_t primary_key() const { return token_id; }
+  eosio::checksum256 by_chain() const { return chain_code; }
+};
+typedef eosio::multi_index<"assetsa"_n, baseline_asset, eosio::indexed_by<"bychain"_n,
+  eosio::const_mem_fun<baseline_asset, eosio::checksum256, &baseline_asset::by_chain>>>
+  baseline_assets;
+struct config_row {
+  name               manager;
+  eosio::checksum256 chain_id;
+  uint64_t           last_token_id;
+  bool               withdraw_flag;
+};
+struct stat_row {
+  asset supply;
+  asset max_supply;
+  name  issuer;
+
+  uint64_t primary_key() const { return supply.symbol.code().raw(); }
+};
+struct liq_account {
+  asset balance;
+
+  uint64_t primary_key() const { return balance.symbol.code().raw(); }
+};
+
+// an ABC pool of the original contract: its asset row, LIQ token and the LP's LIQ
+//   balance, written as that contract did, with the pool held by oswaps
+static void test_migrate_baseline() {
+  mock::chain c;
+  for (name a : {manager, lp, attacker}) {
+    c.create_account(a);
+  }
+  set_token_contract(c, token_acct);
+  set_oswaps_contract(c, oswaps_acct);
+  const symbol liqb(eosio::symbol_code("LIQB"), 4);
+  c.set_action(oswaps_acct, "putbaseline"_n, [&](name, name, const std::vector<char>&) {
+    const eosio::checksum256 telos = eosio::checksum256::make_from_word_sequence<uint64_t>(
+      0x4667b205c6838ef7u, 0x0ff7988f6e8257e8u, 0xbe0e1284a2f59699u, 0x054a018f743b1d11u);
+    eosio::singleton<"configs"_n, config_row> configset(oswaps_acct, oswaps_acct.value);
+    configset.set({manager, telos, 1, false}, oswaps_acct);
+    baseline_assets assets(oswaps_acct, oswaps_acct.value);
+    assets.emplace(oswaps_acct, [&](auto& s) {
+      s = {1, telos, token_acct, abc.code(), true, std::string("{\"name\":\"ABC\"}"), 1.0f};
+    });
+    eosio::multi_index<"stat"_n, stat_row> stats(oswaps_acct, liqb.code().raw());
+    stats.emplace(oswaps_acct, [&](auto& s) {
+      s = {asset(100000000, liqb), asset(eosio::asset::max_amount, liqb), oswaps_acct};
+    });
+    eosio::multi_index<"accounts"_n, liq_account> liq(oswaps_acct, lp.value);
+    liq.emplace(oswaps_acct, [&](auto& s) { s.balance = asset(100000000, liqb); });
+  });
+  pool::expect_ok(c.push_transaction({
+    act(token_acct, "create"_n, token_acct, lp, asset(1000000000, abc)),
+    act(token_acct, "issue"_n, lp, lp, asset(1000000000, abc), std::string()),
+    act(token_acct, "transfer"_n, lp, lp, oswaps_acct, asset(100000000, abc), std::string()),
+    act(token_acct, "transfer"_n, lp, lp, attacker, asset(10000000, abc), std::string()),
+    act(oswaps_acct, "putbaseline"_n, oswaps_acct) }), "baseline pool");
+  pool::expect_ok(c.push_action(oswaps_acct, "migrate"_n, permission_level(manager, "active"_n),
+                                manager, uint32_t(10)), "migrate");
+  EXPECT(c.rows<baseline_asset>(oswaps_acct, oswaps_acct.value, "assetsa"_n).empty(),
+         "baseline row left behind");
+  auto rows = c.rows<asset_deposits>(oswaps_acct, oswaps_acct.value, "tokensa"_n);
+  EXPECT(rows.size() == 1, "%zu migrated rows", rows.size());
+  if (rows.size() == 1) {
+    const asset_deposits& a = rows[0];
+    EXPECT(a.token_id == 1 && a.contract_name == token_acct && a.symbol == abc.code() && a.active,
+           "migrated identity");
+    EXPECT(a.weight == 1000000000, "migrated weight %llu", (unsigned long long)a.weight);
+    EXPECT(a.balance == asset(100000000, abc), "migrated balance %s", a.balance.to_string().c_str());
+    EXPECT(a.liq_symbol == liqb, "migrated LIQ symbol %s", a.liq_symbol.code().to_string().c_str());
+    EXPECT(a.fees == asset(0, abc) && a.deposits == asset(0, abc) && a.fee_rate == 0,
+           "migrated fees and deposits");
+  }
+  // the migrated pool trades and its LP can withdraw
+  pool::expect_ok(c.push_transaction({ act(oswaps_acct, "unfreeze"_n, manager, manager,
+                                           uint64_t(1), std::string("ABC")) }), "unfreeze");
+  pool::expect_ok(c.push_action(oswaps_acct, "withdraw2"_n, permission_level(manager, "active"_n),
+                                lp, uint64_t(1), asset(10000000, abc), 0.0f), "withdraw");
+  EXPECT(balance_of(c, token_acct, oswaps_acct, abc) == 90000000, "withdrawal not paid");
+  EXPECT(balance_of(c, oswaps_acct, lp, liqb) == 90000000, "LIQ not burned");
+}
+
+// LIQ stats erased alongside asset rows count against the reset budget
+static void test_reset_budget() {
+  pool p;
+  auto a = p.c.rows<asset_deposits>(oswaps_acct, oswaps_acct.value, "tokensa"_n);
+  auto liq_stats = [&](const asset_deposits& row) {
+    return p.c.rows<stat_row>(oswaps_acct, row.liq_symbol.code().raw(), "stat"_n).size();
+  };
+  EXPECT(liq_stats(a[0]) == 1 && liq_stats(a[1]) == 1, "pool without LIQ stats");
+  pool::expect_ok(p.c.push_action(oswaps_acct, "reset"_n, permission_level(oswaps_acct, "owner"_n),
+                                  uint32_t(3)), "reset 3");
+  EXPECT(p.assets().size() == 1 && liq_stats(a[0]) == 0 && liq_stats(a[1]) == 0,
+         "reset 3 erased %zu asset rows", 2 - p.assets().size());
+  pool::expect_ok(p.c.push_action(oswaps_acct, "reset"_n, permission_level(oswaps_acct, "owner"_n),
+                                  uint32_t(1)), "reset 1");
+  EXPECT(p.assets().empty(), "asset row left after its LIQ stat");
+}
+
+// operation of a batch
+struct batch_op {
+  name     op;
+  uint64_t token_id;
+  uint64_t out_token_id;
+  asset    amount;
+  int64_t  min_out;
+  float    weight;
+};
+
+// events of one action take consecutive seqs and the sequence is saved once it ends
+static void test_event_seq() {
+  pool p;
+  std::vector<uint64_t> seqs;
+  for (name log : {"logswap"_n, "logliq"_n}) {
+    p.c.set_action(oswaps_acct, log, [&](name, name, const std::vector<char>& data) {
+      seqs.push_back(eosio::unpack<uint64_t>(data));
+    });
+  }
+  pool::expect_ok(p.c.push_action(token_acct, "transfer"_n, permission_level(attacker, "active"_n),
+                                  attacker, oswaps_acct, asset(100000, abc), std::string("#D")),
+                  "deposit");
+  std::vector<batch_op> ops(3, batch_op{"swap"_n, 1, 2, asset(10000, abc), 0, 0.0f});
+  pool::expect_ok(p.c.push_action(oswaps_acct, "batch"_n, permission_level(attacker, "active"_n),
+                                  attacker, ops), "batch");
+  pool::expect_ok(p.c.push_action(token_acct, "transfer"_n, permission_level(attacker, "active"_n),
+                                  attacker, oswaps_acct, asset(10000, abc), std::string("#F,2,,0")),
+                  "swap");
+  bool consecutive = seqs.size() == 4;
+  for (size_t k = 1; k < seqs.size(); ++k) {
+    consecutive = consecutive && seqs[k] == seqs[0] + k;
+  }
+  EXPECT(consecutive, "%zu events with non-consecutive seqs", seqs.size());
+  auto saved = p.c.rows<uint64_t>(oswaps_acct, oswaps_acct.value, "eventseqs"_n);
+  EXPECT(saved.size() == 1 && !seqs.empty() && saved[0] == seqs.back(),
+         "saved seq differs from the last event");
+}
+
+// entry of a querypool or querypage result
+struct status_entry {
+  uint64_t token_id;
+  asset    balance;
+  uint64_t weight;
+};
+
+// an empty querypool list reads the whole pool only while it fits in one page
+static void test_querypool_cap() {
+  pool p;
+  auto all = [&] {
+    return p.c.push_action(oswaps_acct, "querypool"_n, permission_level(attacker, "active"_n),
+                           std::vector<uint64_t>());
+  };
+  auto r = all();
+  EXPECT(r && eosio::unpack<std::vector<status_entry>>(r.return_value).size() == 2,
+         "querypool of the pool: %s", r.error.c_str());
+  for (int k = 0; k < 99; ++k) {
+    symbol s(eosio::symbol_code(std::string{'T', char('A' + k / 26), char('A' + k % 26)}), 4);
+    pool::expect_ok(p.c.push_transaction({
+      act(token_acct, "create"_n, token_acct, lp, asset(1000000000, s)),
+      act(oswaps_acct, "createasseta"_n, lp, lp, std::string("Telos"), token_acct, s.code(),
+          std::string()) }), "create token");
+  }
+  r = all();
+  EXPECT(r.error == "eosio_assert: pool has more than 100 tokens, use querypage",
+         "querypool of 101 tokens: %s", r.error.c_str());
+}
+
+// a queued withdrawal which would round a weight to zero is dropped, not left blocking
+static void test_crank_tiny_weight() {
+  pool p;
+  pool::expect_ok(p.c.push_transaction({
+    act(oswaps_acct, "addliqprep2"_n, lp, lp, uint64_t(1), asset(1, abc), 1.0e-9f),
+    act(token_acct, "transfer"_n, lp, lp, oswaps_acct, asset(1, abc), std::string()) }),
+    "tiny weight");
+  EXPECT(p.assets()[0].weight == 1, "weight %llu", (unsigned long long)p.assets()[0].weight);
+  for (auto q : {std::make_pair(uint64_t(1), asset(10000, abc)),
+                 std::make_pair(uint64_t(2), asset(10000, xyz))}) {
+    pool::expect_ok(p.c.push_action(oswaps_acct, "withdrawq"_n,
+                                    permission_level(manager, "active"_n), lp, q.first, q.second),
+                    "withdrawq");
+  }
+  auto r = p.c.push_action(oswaps_acct, "crank"_n, permission_level(attacker, "active"_n),
+                           uint32_t(2));
+  EXPECT(r, "crank: %s", r.error.c_str());
+  EXPECT(p.c.rows<uint64_t>(oswaps_acct, oswaps_acct.value, "withdrawals"_n).empty(),
+         "withdrawals left queued");
+  EXPECT(p.held(abc) == 100000001 && p.held(xyz) == 99990000, "crank payouts");
+}
+
+// a batch cannot change a weight, or freeze a token, without adding liquidity
+static void test_batch_zero_addliq() {
+  pool p;
+  std::vector<batch_op> ops{batch_op{"addliq"_n, 1, 0, asset(0, abc), 0, 5.0f}};
+  auto r = p.c.push_action(oswaps_acct, "batch"_n, permission_level(attacker, "active"_n),
+                           attacker, ops);
+  EXPECT(r.error == "eosio_assert: liquidity amount must be positive",
+         "zero-amount addliq: %s", r.error.c_str());
+  EXPECT(p.assets()[0].weight == 1000000000 && p.assets()[0].active,
+         "weight or state changed by a zero-amount addliq");
+}
+
+// a plain transfer may follow any oswaps action which is not a prep action
+static void test_transfer_after_action() {
+  pool p;
+  pool::expect_ok(p.c.push_action(token_acct, "transfer"_n, permission_level(attacker, "active"_n),
+                                  attacker, oswaps_acct, asset(100000, abc), std::string("#D")),
+                  "deposit");
+  // fees for the LP to claim
+  pool::expect_ok(p.c.push_action(oswaps_acct, "setfee"_n, permission_level(manager, "active"_n),
+                                  manager, uint64_t(1), std::string("ABC"), 0.01f), "setfee");
+  pool::expect_ok(p.c.push_action(token_acct, "transfer"_n, permission_level(attacker, "active"_n),
+                                  attacker, oswaps_acct, asset(100000, abc), std::string("#F,2,,0")),
+                  "swap");
+  auto gift = [](symbol s) {
+    return act(token_acct, "transfer"_n, attacker, attacker, oswaps_acct, asset(100, s),
+               std::string("gift"));
+  };
+  auto r = p.c.push_transaction({act(oswaps_acct, "claimfees"_n, lp, lp, uint64_t(1)),
+                                 act(token_acct, "transfer"_n, lp, lp, oswaps_acct,
+                                     asset(100, xyz), std::string("gift"))});
+  EXPECT(r, "claimfees then transfer: %s", r.error.c_str());
+  for (const eosio::action& a : {
+                                 act(oswaps_acct, "swapint"_n, attacker, attacker, uint64_t(1),
+                                     uint64_t(2), asset(10000, abc), int64_t(0)),
+                                 act(oswaps_acct, "depwithdraw"_n, attacker, attacker, uint64_t(1),
+                                     asset(10000, abc))}) {
+    auto r = p.c.push_transaction({a, gift(xyz)});
+    EXPECT(r, "%s then transfer: %s", a.name.to_string().c_str(), r.error.c_str());
+  }
+}
+
+// token ids continue after a reset, so pre-reset LIQ balances stay stale and collectable
+static void test_reset_token_ids() {
+  pool p;
+  const symbol liqb(eosio::symbol_code("LIQB"), 4);
+  const symbol liqd(eosio::symbol_code("LIQD"), 4);
+  for (int k = 0; k < 3; ++k) {
+    pool::expect_ok(p.c.push_action(oswaps_acct, "reset"_n, permission_level(oswaps_acct, "owner"_n),
+                                    uint32_t(100)), "reset");
+  }
+  pool::expect_ok(p.c.push_action(oswaps_acct, "init"_n, permission_level(oswaps_acct, "owner"_n),
+                                  manager, std::string("Telos")), "init");
+  pool::expect_ok(p.c.push_action(oswaps_acct, "createasseta"_n, permission_level(lp, "active"_n),
+                                  lp, std::string("Telos"), token_acct, abc.code(), std::string()),
+                  "create token");
+  auto a = p.c.rows<asset_deposits>(oswaps_acct, oswaps_acct.value, "tokensa"_n);
+  EXPECT(a.size() == 1 && a[0].token_id == 3 && a[0].liq_symbol == liqd,
+         "token id %llu after reset", a.empty() ? 0ull : (unsigned long long)a[0].token_id);
+  EXPECT(balance_of(p.c, oswaps_acct, lp, liqb) == 100000000, "pre-reset LIQ balance missing");
+  pool::expect_ok(p.c.push_action(oswaps_acct, "gc"_n, permission_level(attacker, "active"_n),
+                                  lp, uint32_t(10)), "gc");
+  EXPECT(balance_of(p.c, oswaps_acct, lp, liqb) == 0, "gc left the pre-reset LIQ balance");
+}
+
+struct swap_request {
+  uint64_t in_token_id;
+  uint64_t out_token_id;
+  asset    amount;
+  bool     exact_in;
+};
+struct quote_entry {
+  asset  in_amount;
+  asset  out_amount;
+  double spot_price;
+  double price_impact;
+  name   status;
+};
+
+// quotes report frozen and rate-limited swaps per entry
+static void test_quote_status() {
+  pool p;
+  pool::expect_ok(p.c.push_action(oswaps_acct, "setlimit"_n, permission_level(manager, "active"_n),
+                                  manager, uint64_t(1), asset(50000, abc), asset(1, abc)),
+                  "setlimit");
+  auto quote = [&](std::vector<swap_request> requests) {
+    auto r = p.c.push_action(oswaps_acct, "quote"_n, permission_level(attacker, "active"_n),
+                             requests);
+    EXPECT(r, "quote: %s", r.error.c_str());
+    return r ? eosio::unpack<std::vector<quote_entry>>(r.return_value)
+             : std::vector<quote_entry>();
+  };
+  auto q = quote({{2, 1, asset(10000, xyz), true}, {2, 1, asset(100000, abc), false}});
+  EXPECT(q.size() == 2 && q[0].status == "ok"_n && q[0].out_amount.amount > 0
+         && q[1].status == "ratelimited"_n && q[1].out_amount.amount == 0,
+         "rate-limited quote");
+  pool::expect_ok(p.c.push_action(oswaps_acct, "freeze"_n, permission_level(manager, "active"_n),
+                                  manager, uint64_t(2), std::string("XYZ")), "freeze");
+  q = quote({{2, 1, asset(10000, xyz), true}, {1, 2, asset(10000, abc), true}});
+  EXPECT(q.size() == 2 && q[0].status == "frozen"_n && q[1].status == "frozen"_n
+         && q[0].in_amount.amount == 0 && q[1].spot_price > 0.0, "frozen quote");
+}
+
+// row of the oswaps withdrawals queue
+struct withdrawal_row {
+  uint64_t id;
+  name     account;
+  uint64_t token_id;
+  asset    amount;
+};
+
+// a crank bills no fee checkpoint to the contract; the manager pays for it when queueing
+static void test_crank_checkpoint_ram() {
+  pool p;
+  pool::expect_ok(p.c.push_action(oswaps_acct, "setfee"_n, permission_level(manager, "active"_n),
+                                  manager, uint64_t(1), std::string("ABC"), 0.01f), "setfee");
+  pool::expect_ok(p.c.push_action(token_acct, "transfer"_n, permission_level(attacker, "active"_n),
+                                  attacker, oswaps_acct, asset(100000, abc), std::string("#F,2,,0")),
+                  "swap");
+  // the token contract bills oswaps' ABC balance row to oswaps on its first ABC payout
+  pool::expect_ok(p.c.push_action(token_acct, "transfer"_n, permission_level(attacker, "active"_n),
+                                  attacker, oswaps_acct, asset(100000, xyz), std::string("#F,1,,0")),
+                  "swap back");
+  EXPECT(p.c.rows<deposit_row>(oswaps_acct, lp.value, "lpfees"_n).empty(), "LP checkpoint exists");
+  int64_t manager_ram = p.c.ram_usage(manager);
+  pool::expect_ok(p.c.push_action(oswaps_acct, "withdrawq"_n, permission_level(manager, "active"_n),
+                                  lp, uint64_t(1), asset(10000, abc)), "withdrawq");
+  EXPECT(p.c.rows<deposit_row>(oswaps_acct, lp.value, "lpfees"_n).size() == 1,
+         "withdrawq made no checkpoint");
+  EXPECT(p.c.ram_usage(manager) > manager_ram, "manager paid nothing");
+  int64_t oswaps_ram = p.c.ram_usage(oswaps_acct);
+  pool::expect_ok(p.c.push_action(oswaps_acct, "crank"_n, permission_level(attacker, "active"_n),
+                                  uint32_t(1)), "crank");
+  EXPECT(p.c.ram_usage(oswaps_acct) == oswaps_ram, "crank billed %lld bytes to the contract",
+         (long long)(p.c.ram_usage(oswaps_acct) - oswaps_ram));
+  EXPECT(p.c.rows<withdrawal_row>(oswaps_acct, oswaps_acct.value, "withdrawals"_n).empty(),
+         "withdrawal not processed");
+}
+
+int main() {
+  test_forwarded_swap();
+  test_forwarded_intent();
+  test_settle_budget();
+  test_deposits();
+  test_migrate_baseline();
+  test_reset_budget();
+  test_event_seq();
+  test_querypool_cap();
+  test_crank_tiny_weight();
+  test_batch_zero_addliq();
+  test_transfer_after_action();
+  test_reset_token_ids();
+  test_quote_status();
+  test_crank_checkpoint_ram();
+  if (failures) {
+    printf("%d FAILED\n", failures);
+  } else {
+    printf("all passed\n");
+  }
+  return failures ? 1 : 0;
+}